@@ -0,0 +1,115 @@
+// Buffer cache internals shared by bio.c and the replacement
+// policies in bio_*.c.  Nothing else should include this file.
+//
+// bio.c owns lookup, locking and reference counts.  A policy
+// only decides which queue each buffer sits on and which buffer
+// to give to a block that is not cached.
+
+// Queue a buffer sits on, kept in b->buf_type.  Every policy
+// sorts resident blocks into at most two queues: M for blocks
+// that have been re-referenced and S for probationary ones.
+#define BQ_M    0
+#define BQ_S    1
+#define BQ_FREE 2  // holds no block
+
+// Hints to a policy's alloc about the block coming in are the
+// BH_ flags of buf.h.  A block read with BH_NOREUSE keeps
+// B_NOREUSE until it is read without: policies must keep such
+// a block out of M and out of their ghost queues.
+
+// A replacement policy.  bio.c calls the hooks holding no
+// bucket lock; a policy guards its queues with its own
+// spinlocks, so hooks must not sleep.
+struct bpolicy {
+  char *name;
+  // Take over the n buffers on list, none of which holds a
+  // block.  nsmall of them are meant for the probationary
+  // queue, for policies that size it; with adapt set, nsmall
+  // is only where to start.
+  void (*init)(struct buf *list, int n, int nsmall, int adapt);
+  // b was found by a lookup; the caller holds a reference.
+  void (*hit)(struct buf *b);
+  // Choose a buffer for (dev, blockno), which is not cached,
+  // and queue it.  Called with bcache.evict held, so allocs
+  // never overlap.  The buffer must have been taken with
+  // bclaim(); b->dev and b->blockno still name the block it is
+  // evicting.  hint holds BH_ flags.  Returns 0 if every
+  // buffer is in use.  bio.c retries a failed alloc, over the
+  // class quota or after sleeping, so one that returns 0 must
+  // leave what it knows of the block (ghost entries, adaptive
+  // targets, counts) for the retry.
+  struct buf *(*alloc)(uint dev, uint blockno, int hint);
+  // brelse() dropped the last reference to b.  b may have been
+  // claimed again by the time this runs, so it is only a hint.
+  void (*release)(struct buf *b);
+  // The probationary queue's current target size, or 0 if the
+  // policy has none.  For bcstat only; need not be exact.
+  int (*ssize)(void);
+};
+
+extern struct bpolicy lru_policy;
+extern struct bpolicy s3fifo_policy;
+extern struct bpolicy clock_policy;
+extern struct bpolicy twoq_policy;
+extern struct bpolicy arc_policy;
+
+// bio.c: counters are kept per CPU, each on its own cache
+// lines, and summed by bstat().  Next to them is the CPU's
+// front cache, buffers it released recently, each still holding
+// the reference it was released with; a slot is taken or
+// emptied only with xchg.
+#define CACHELINE 64
+
+struct bcpu {
+  struct bcstat st;
+  struct buf *front[NFRONT];  // slot bhash() % NFRONT
+} __attribute__((aligned(CACHELINE)));
+
+extern struct bcpu bcpus[NCPU];
+
+#define BCOUNT(f) do { pushcli(); bcpus[cpuid()].st.f++; popcli(); } while(0)
+
+int             bclaim(struct buf*);
+void*           bpage(void);
+
+static inline uint
+bhash(uint dev, uint blockno)
+{
+  return dev*31 + blockno;
+}
+
+// bio_queue.c: doubly-linked buffer lists through prev/next,
+// headed by a sentinel; head.next is the most recent end.
+void            linit(struct buf*);
+void            lremove(struct buf*);
+void            lpush(struct buf*, struct buf*);
+struct buf*     lclaim(struct buf*);
+
+// bio_queue.c: ghost queues, FIFO rings remembering only the
+// (dev, blockno) of evicted blocks, with hash chains for lookup.
+struct ghost {
+  uint dev;
+  uint blockno;
+  int next;  // hash chain, ring index; -1 ends it
+  int used;
+};
+
+// The ring is kept in pages found through a directory page,
+// since kalloc() hands out one page at a time.
+#define GPP (PGSIZE/sizeof(struct ghost))  // entries per page
+
+struct ghostq {
+  struct ghost **dir; // ring of size entries, GPP per page
+  int size;
+  int head;           // oldest slot
+  int len;            // slots from head in use or holes
+  int n;              // entries in use
+  int *hash;          // nhash chain heads
+  int nhash;
+};
+
+void            gqinit(struct ghostq*, int);
+int             gqfind(struct ghostq*, uint, uint);
+void            gqremove(struct ghostq*, int);
+void            gqadd(struct ghostq*, uint, uint);
+void            gqpop(struct ghostq*);
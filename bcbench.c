@@ -0,0 +1,103 @@
+// Buffer cache scaling benchmark.
+//
+// bcbench [maxprocs] runs 1, 2, 4, ... maxprocs processes at
+// once, each reading its own file over and over, and prints the
+// ticks each round took.  Every process does the same work, and
+// once the files are cached every block read is a cache hit, so
+// with enough CPUs (make qemu CPUS=4) a cache whose lookups do
+// not contend keeps the time flat as processes are added.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fs.h"
+#include "fcntl.h"
+#include "bcstat.h"
+
+#define NBLOCK  32   // blocks in each process's file
+#define ROUNDS 300   // times each process reads its file
+
+char buf[BSIZE];
+char name[] = "bcbench.00";
+
+char*
+fname(int i)
+{
+  name[8] = '0' + i/10;
+  name[9] = '0' + i%10;
+  return name;
+}
+
+void
+mkfile(int i)
+{
+  int fd, n;
+
+  if((fd = open(fname(i), O_CREATE|O_RDWR)) < 0){
+    printf(2, "bcbench: cannot create %s\n", fname(i));
+    exit();
+  }
+  for(n = 0; n < NBLOCK; n++){
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      printf(2, "bcbench: write %s failed\n", fname(i));
+      exit();
+    }
+  }
+  close(fd);
+}
+
+void
+readfile(int i, int rounds)
+{
+  int fd, r;
+
+  for(r = 0; r < rounds; r++){
+    if((fd = open(fname(i), O_RDONLY)) < 0){
+      printf(2, "bcbench: cannot open %s\n", fname(i));
+      exit();
+    }
+    while(read(fd, buf, sizeof(buf)) == sizeof(buf))
+      ;
+    close(fd);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct bcstat st;
+  int maxp, n, i, t;
+
+  maxp = argc > 1 ? atoi(argv[1]) : 4;
+  if(argc > 2 || maxp < 1 || maxp > 32){
+    printf(2, "usage: bcbench [maxprocs (1-32)]\n");
+    exit();
+  }
+
+  for(i = 0; i < maxp; i++){
+    mkfile(i);
+    readfile(i, 1);
+  }
+
+  for(n = 1; n <= maxp; n *= 2){
+    bcstat(&st, 1);
+    t = uptime();
+    for(i = 0; i < n; i++){
+      if(fork() == 0){
+        readfile(i, ROUNDS);
+        exit();
+      }
+    }
+    for(i = 0; i < n; i++)
+      wait();
+    t = uptime() - t;
+    bcstat(&st, 0);
+    printf(1, "%d procs: %d ticks, %d lookups, %d misses\n", n, t,
+           st.mhits + st.shits + st.pinhits + st.fronthits + st.misses,
+           st.misses);
+  }
+
+  for(i = 0; i < maxp; i++)
+    unlink(fname(i));
+  exit();
+}
@@ -0,0 +1,371 @@
+// Buffer cache simulator: replays a block trace through the
+// kernel's replacement policies (bio_*.c, compiled unchanged
+// for the host) and reports the hit ratio per cache size.
+//
+//   make bcsim
+//   ./bcsim [-p policy] [-s small%] [-f] size... < trace
+//   ./bcsim -t [-p policy]
+//
+// A trace has one access per line, "dev blockno r" or
+// "dev blockno w", the format printed by "btrace -a" in xv6.
+// Every line is a lookup; a w also dirties the block, and
+// evicting a dirty block counts as a write-back.  Without -p,
+// every policy is run.  -f keeps the probationary share fixed
+// at small%, as BCADAPT=0 does in the kernel; the S column is
+// the policy's target for it at the end of the run.
+//
+// -t replays no trace but checks each policy: an alloc whose
+// claims are all refused, as the kernel's class quota refuses
+// them, must not change what the retry does with the block.
+//
+// This file stands in for the core of bio.c: the lookup hash,
+// reference counts, bclaim() and the counters.  There is no
+// disk, no concurrency and nothing is held across accesses.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "types.h"
+#include "param.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "buf.h"
+#include "bcstat.h"
+#include "bcache.h"
+
+#define NELEM(x) (sizeof(x)/sizeof((x)[0]))
+
+static struct bpolicy *policies[] = {
+  &lru_policy,
+  &s3fifo_policy,
+  &clock_policy,
+  &twoq_policy,
+  &arc_policy,
+};
+
+struct access {
+  uint dev;
+  uint blockno;
+  int write;
+};
+
+struct access *trace;
+int ntrace;
+
+struct buf *bufs;
+struct buf **hash;
+int nhash;
+uint writebacks;
+int refuse;  // bclaim() fails, for -t
+
+// Pages handed out by bpage() for the current run.
+void **pages;
+int npages, maxpages;
+
+// What the policies need from the kernel.
+
+struct bcpu bcpus[NCPU];
+
+void
+panic(char *s)
+{
+  fprintf(stderr, "bcsim: panic: %s\n", s);
+  exit(1);
+}
+
+void initlock(struct spinlock *lk, char *name) { }
+void acquire(struct spinlock *lk) { }
+void release(struct spinlock *lk) { }
+void pushcli(void) { }
+void popcli(void) { }
+int cpuid(void) { return 0; }
+
+void*
+bpage(void)
+{
+  if(npages == maxpages){
+    maxpages = maxpages ? 2*maxpages : 64;
+    if((pages = realloc(pages, maxpages*sizeof(pages[0]))) == 0)
+      panic("bpage");
+  }
+  if((pages[npages] = calloc(1, PGSIZE)) == 0)
+    panic("bpage");
+  return pages[npages++];
+}
+
+static struct buf**
+hslot(uint dev, uint blockno)
+{
+  return &hash[bhash(dev, blockno) % nhash];
+}
+
+static struct buf*
+hlookup(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  for(b = *hslot(dev, blockno); b != 0; b = b->hnext)
+    if(b->dev == dev && b->blockno == blockno)
+      return b;
+  return 0;
+}
+
+static void
+hremove(struct buf *b)
+{
+  struct buf **pp;
+
+  for(pp = hslot(b->dev, b->blockno); *pp != 0; pp = &(*pp)->hnext){
+    if(*pp == b){
+      *pp = b->hnext;
+      return;
+    }
+  }
+}
+
+// Nothing is held between accesses, so every buffer is free
+// to go; a dirty one must be written back first.
+int
+bclaim(struct buf *b)
+{
+  if(refuse || b->refcnt != 0)
+    return 0;
+  if(b->flags & B_DIRTY)
+    writebacks++;
+  hremove(b);
+  b->refcnt = 1;
+  return 1;
+}
+
+// One lookup, as bread() and brelse() would do it.
+static void
+access(struct bpolicy *p, struct access *a)
+{
+  struct buf *b;
+
+  if((b = hlookup(a->dev, a->blockno)) != 0){
+    if(b->buf_type == BQ_M)
+      bcpus[0].st.mhits++;
+    else
+      bcpus[0].st.shits++;
+    b->refcnt++;
+    p->hit(b);
+  } else {
+    bcpus[0].st.misses++;
+    if((b = p->alloc(a->dev, a->blockno, 0)) == 0)
+      panic("no buffer");
+    if(b->flags & B_VALID)
+      bcpus[0].st.evictions++;
+    b->dev = a->dev;
+    b->blockno = a->blockno;
+    b->flags = B_VALID;
+    b->hnext = *hslot(b->dev, b->blockno);
+    *hslot(b->dev, b->blockno) = b;
+  }
+  if(a->write)
+    b->flags |= B_DIRTY;
+  if(--b->refcnt == 0)
+    p->release(b);
+}
+
+static double
+now(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// Give p a cache of n empty buffers.
+static void
+setup(struct bpolicy *p, int n, int small, int adapt)
+{
+  struct buf list;
+  int i;
+
+  memset(bcpus, 0, sizeof(bcpus));
+  writebacks = 0;
+  nhash = n;
+  if((bufs = calloc(n, sizeof(struct buf))) == 0 ||
+     (hash = calloc(nhash, sizeof(struct buf*))) == 0)
+    panic("out of memory");
+  linit(&list);
+  for(i = 0; i < n; i++)
+    lpush(&list, &bufs[i]);
+  p->init(&list, n, n * small / 100, adapt);
+}
+
+static void
+teardown(void)
+{
+  int i;
+
+  free(bufs);
+  free(hash);
+  for(i = 0; i < npages; i++)
+    free(pages[i]);
+  npages = 0;
+}
+
+static void
+run(struct bpolicy *p, int n, int small, int adapt)
+{
+  struct bcstat *st = &bcpus[0].st;
+  double t;
+  uint hits;
+  int i;
+
+  setup(p, n, small, adapt);
+  t = now();
+  for(i = 0; i < ntrace; i++)
+    access(p, &trace[i]);
+  t = now() - t;
+
+  hits = st->mhits + st->shits;
+  printf("%-7s %6d %10u %10u %7.2f%% %9u %9u %8.2f %6d\n",
+         p->name, n, hits, st->misses, 100.0 * hits / ntrace,
+         st->promotions, writebacks, t > 0 ? ntrace / t / 1e6 : 0.0,
+         p->ssize());
+  teardown();
+}
+
+// Fill a cache of 4 with blocks 2-4 hit once each, so that
+// block 5 pushes block 1, never hit, out into a ghost queue
+// under every policy that keeps one; then read block 1 again,
+// first with every claim refused if refused is set.  Returns
+// the queue block 1 lands on, and its ghost hits in *ghits.
+static int
+replay(struct bpolicy *p, int refused, uint *ghits)
+{
+  static uint blocks[] = { 1, 2, 2, 3, 3, 4, 4, 5 };
+  struct access a = { 1, 0, 0 };
+  int i, q;
+
+  setup(p, 4, 25, 1);
+  for(i = 0; i < NELEM(blocks); i++){
+    a.blockno = blocks[i];
+    access(p, &a);
+  }
+  a.blockno = 1;
+  if(refused){
+    refuse = 1;
+    if(p->alloc(a.dev, a.blockno, 0) != 0)
+      panic("claimed a refused buffer");
+    refuse = 0;
+  }
+  access(p, &a);
+  q = hlookup(a.dev, a.blockno)->buf_type;
+  *ghits = bcpus[0].st.ghits;
+  teardown();
+  return q;
+}
+
+// Check that a refused alloc leaves p's view of the block
+// alone.  Returns 0 if it does.
+static int
+check(struct bpolicy *p)
+{
+  uint g0, g1;
+  int q0, q1;
+
+  q0 = replay(p, 0, &g0);
+  q1 = replay(p, 1, &g1);
+  if(q0 != q1 || g0 != g1){
+    printf("%-7s FAIL: block on %s with %u ghost hits, %s with %u after a refused alloc\n",
+           p->name, q0 == BQ_M ? "M" : "S", g0, q1 == BQ_M ? "M" : "S", g1);
+    return 1;
+  }
+  printf("%-7s ok: block on %s with %u ghost hits\n", p->name, q0 == BQ_M ? "M" : "S", g0);
+  return 0;
+}
+
+static void
+readtrace(FILE *f)
+{
+  char line[128], rw;
+  uint dev, blockno;
+  int max = 0;
+
+  while(fgets(line, sizeof(line), f)){
+    if(sscanf(line, "%u %u %c", &dev, &blockno, &rw) != 3 || (rw != 'r' && rw != 'w'))
+      continue;
+    if(ntrace == max){
+      max = max ? 2*max : 1<<16;
+      if((trace = realloc(trace, max*sizeof(trace[0]))) == 0)
+        panic("out of memory");
+    }
+    trace[ntrace].dev = dev;
+    trace[ntrace].blockno = blockno;
+    trace[ntrace].write = rw == 'w';
+    ntrace++;
+  }
+}
+
+static void
+usage(void)
+{
+  fprintf(stderr, "usage: bcsim [-p policy] [-s small%%] [-f] size... < trace\n"
+          "       bcsim -t [-p policy]\n");
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct bpolicy *p = 0;
+  int i, j, small = BCSMALL, adapt = BCADAPT, test = 0, fail = 0;
+
+  for(i = 1; i < argc && argv[i][0] == '-'; i++){
+    if(strcmp(argv[i], "-p") == 0 && i+1 < argc){
+      i++;
+      for(j = 0; j < NELEM(policies); j++)
+        if(strcmp(policies[j]->name, argv[i]) == 0)
+          p = policies[j];
+      if(p == 0){
+        fprintf(stderr, "bcsim: unknown policy %s\n", argv[i]);
+        exit(1);
+      }
+    } else if(strcmp(argv[i], "-s") == 0 && i+1 < argc){
+      small = atoi(argv[++i]);
+      if(small < 0 || small > 100)
+        usage();
+    } else if(strcmp(argv[i], "-f") == 0)
+      adapt = 0;
+    else if(strcmp(argv[i], "-t") == 0)
+      test = 1;
+    else
+      usage();
+  }
+  if(test){
+    for(j = 0; j < NELEM(policies); j++)
+      if(p == 0 || p == policies[j])
+        fail |= check(policies[j]);
+    return fail;
+  }
+  if(i == argc)
+    usage();
+
+  readtrace(stdin);
+  if(ntrace == 0){
+    fprintf(stderr, "bcsim: empty trace\n");
+    exit(1);
+  }
+
+  printf("%d accesses\n", ntrace);
+  printf("%-7s %6s %10s %10s %8s %9s %9s %8s %6s\n",
+         "policy", "size", "hits", "misses", "ratio",
+         "promoted", "wrback", "Macc/s", "S");
+  for(; i < argc; i++){
+    if(atoi(argv[i]) < 2)
+      usage();
+    for(j = 0; j < NELEM(policies); j++)
+      if(p == 0 || p == policies[j])
+        run(policies[j], atoi(argv[i]), small, adapt);
+  }
+  return 0;
+}
@@ -0,0 +1,88 @@
+// Print the buffer cache counters.
+// bcstat -r also clears them after printing; bcstat -l also
+// prints the bread() latency histograms.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "bcstat.h"
+
+char *kinds[NLATKIND] = {
+[LAT_MHIT]  "M hits",
+[LAT_SHIT]  "S hits",
+[LAT_GMISS] "ghost misses",
+[LAT_MISS]  "cold misses",
+};
+
+// Print the nonzero buckets of log2 histogram h, if any.
+void
+phist(char *what, char *kind, uint *h)
+{
+  int i;
+  uint n;
+
+  n = 0;
+  for(i = 0; i < NLAT; i++)
+    n += h[i];
+  if(n == 0)
+    return;
+  printf(1, "%s, %s (%d), cycles:\n", what, kind, n);
+  for(i = 0; i < NLAT; i++){
+    if(h[i] != 0)
+      printf(1, "  2^%d%s\t%d\n", i, i == NLAT-1 ? "+" : "", h[i]);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct bcstat st;
+  int i, reset, lat;
+  uint hits, lookups;
+
+  reset = lat = 0;
+  for(i = 1; i < argc; i++){
+    if(strcmp(argv[i], "-r") == 0)
+      reset = 1;
+    else if(strcmp(argv[i], "-l") == 0)
+      lat = 1;
+    else {
+      printf(2, "usage: bcstat [-r] [-l]\n");
+      exit();
+    }
+  }
+  if(bcstat(&st, reset) < 0){
+    printf(2, "bcstat: failed\n");
+    exit();
+  }
+
+  printf(1, "buffers %d: metadata %d, data %d (at most %d)\n",
+         st.nbuf, st.nmeta, st.ndata, st.maxdata);
+  if(st.nbuf > 0)
+    printf(1, "probationary target %d (%d%%)\n",
+           st.nsmall, st.nsmall * 100 / st.nbuf);
+  hits = st.mhits + st.shits + st.pinhits + st.fronthits;
+  lookups = hits + st.misses;
+  printf(1, "lookups %d hits %d (M %d S %d pinned %d front %d) misses %d\n",
+         lookups, hits, st.mhits, st.shits, st.pinhits, st.fronthits,
+         st.misses);
+  if(lookups > 0)
+    printf(1, "hit ratio %d%%\n", hits * 100 / lookups);
+  lookups = st.metahits + st.metamisses;
+  if(lookups > 0)
+    printf(1, "metadata lookups %d hit ratio %d%%\n",
+           lookups, st.metahits * 100 / lookups);
+  printf(1, "ghost hits %d promotions %d evictions %d dirty skips %d\n",
+         st.ghits, st.promotions, st.evictions, st.dirtyskips);
+  printf(1, "disk reads %d (%d requests) writes %d (%d requests)\n",
+         st.reads, st.rreqs, st.writes, st.wreqs);
+  printf(1, "prefetches %d\n", st.prefetches);
+  printf(1, "buffer waits %d (%d ticks)\n", st.allocwaits, st.waitticks);
+  if(lat){
+    for(i = 0; i < NLATKIND; i++)
+      phist("bread", kinds[i], st.lat[i]);
+    for(i = 0; i < NLATKIND; i++)
+      phist("lock wait", kinds[i], st.lockwait[i]);
+  }
+  exit();
+}
@@ -0,0 +1,42 @@
+// Buffer cache counters, filled in by the bcstat system call.
+// Both the kernel and user programs use this header file.
+
+// Kinds of bread() lookup, for the latency histograms.
+#define LAT_MHIT  0  // found in M
+#define LAT_SHIT  1  // found in S
+#define LAT_GMISS 2  // missed, but was in a ghost queue
+#define LAT_MISS  3  // missed, never seen or long forgotten
+#define NLATKIND  4
+
+// Histogram bucket i counts latencies of 2^i to 2^(i+1)-1
+// cycles (bucket 0 also counts 0); the last bucket counts
+// everything longer.
+#define NLAT     32
+
+struct bcstat {
+  uint mhits;       // lookups found in M
+  uint shits;       // lookups found in S
+  uint pinhits;     // lookups of pinned blocks
+  uint fronthits;   // lookups found in the CPU's front cache
+  uint misses;      // lookups not cached
+  uint ghits;       // misses that were in the ghost queue
+  uint promotions;  // blocks moved into M on re-reference
+  uint evictions;   // cached blocks replaced by another block
+  uint dirtyskips;  // eviction candidates passed over as dirty
+  uint reads;       // blocks read from disk
+  uint writes;      // blocks written to disk
+  uint prefetches;  // blocks read ahead
+  uint rreqs;       // disk read requests, each of adjacent blocks
+  uint wreqs;       // disk write requests, each of adjacent blocks
+  uint metahits;    // lookups of metadata blocks that hit
+  uint metamisses;  // lookups of metadata blocks that missed
+  uint allocwaits;  // misses that waited for a free buffer
+  uint waitticks;   // ticks those misses spent waiting
+  uint lat[NLATKIND][NLAT];     // bread() latency, cycles
+  uint lockwait[NLATKIND][NLAT]; // waits for the buffer's lock, cycles
+  uint nbuf;        // buffers in the cache
+  uint nmeta;       // buffers holding metadata
+  uint ndata;       // buffers holding file data
+  uint maxdata;     // most buffers file data may hold
+  uint nsmall;      // probationary queue's target size now
+};
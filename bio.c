@@ -1,6 +1,6 @@
 // Buffer cache.
 //
-// The buffer cache is a linked list of buf structures holding
+// The buffer cache is a set of buf structures holding
 // cached copies of disk block contents.  Caching disk blocks
 // in memory reduces the number of disk reads and also provides
 // a synchronization point for disk blocks used by multiple processes.
@@ -13,291 +13,970 @@
 // * Only one process at a time can use a buffer,
 //     so do not keep them longer than necessary.
 //
-// The implementation uses two state flags internally:
+// This file is the policy-neutral core: lookup, locking and
+// reference counts.  Which buffer a missing block replaces is
+// decided by a replacement policy (see bcache.h and bio_*.c):
+// lru, s3fifo, clock, 2q or arc.  The Makefile's BCPOLICY picks
+// the default, and the boot parameter opt/xv6/bcpolicy
+// (make qemu BOOTBCPOLICY=arc) overrides it without a rebuild.
+//
+// The cache is sized at boot from the memory kinit2() left
+// free: 1/BCFRAC of it, at least NBUF buffers and never more
+// than FSSIZE, the most blocks a disk can hold.  BCSMALL percent
+// of the buffers go to the probationary queue.  Both can be set
+// per boot (opt/xv6/bcfrac and opt/xv6/bcsmall, or make qemu
+// BOOTBCFRAC=64 BOOTBCSMALL=25).  Unless BCADAPT or
+// opt/xv6/bcadapt is 0, BCSMALL is only the starting share:
+// policies that can move it with the workload do (s3fifo).
+// Buffers are carved out of kalloc() pages, as is the
+// policies' bookkeeping.
+//
+// Callers name each block's class: file data (BH_DATA),
+// metadata (BH_META) or the log (BH_LOG).  File data may hold
+// at most BCDATA percent of the buffers (opt/xv6/bcdata, or
+// make qemu BOOTBCDATA=50); at its quota a data miss can only
+// recycle another data buffer, which bclaim() enforces under
+// every policy, so data-heavy work cannot flush the metadata.
+// Log blocks are written at commit and read only by recovery,
+// so they bypass the cache and use LOGSIZE raw buffers of their
+// own (bgetraw).
+//
+// A few metadata blocks needed all the time (the superblock,
+// the bitmap, the root directory) are pinned by bpin() into
+// NPIN buffers that the policy never sees.  They are found
+// through the hash like any block, but a hit on one skips the
+// policy, and they are never evicted.
+//
+// A miss that finds every buffer in use or dirty sleeps until
+// brelse() or write-back frees one (bfreed); bcstat counts how
+// often and how long misses wait.  Only read-ahead gives up.
+//
+// sync() records the blocks in M, the hot set, in a block of
+// the disk (bhotsave); the next boot reads them back in the
+// background (bprewarm) so that it does not start cold.
+//
+// Each CPU keeps the last few clean buffers it released, in a
+// front cache of NFRONT slots (struct bcpu): brelse() leaves
+// the buffer its reference and bget() takes it back, so reading
+// the same directory or inode block again on one CPU takes no
+// lock but the buffer's own.  A buffer displaced from its slot
+// is released for real, and the policy hears of its front hits
+// then, in one hit (b->fhit).  A miss that would wait for a free
+// buffer empties every front cache first (bdrain).
+//
+// Every buffer that holds a block is also linked into a hash
+// table keyed by (dev, blockno) through hnext, so finding a
+// block costs one short chain walk whatever the cache size.
+//
+// Locking.  Each hash bucket has its own spinlock, on its own
+// cache line, guarding the bucket's chain and the refcnt of the
+// buffers on it; a lookup that hits takes nothing else.  A miss
+// takes bcache.evict, which serializes the replacement of
+// blocks: with it held the miss looks the block up again, lets
+// the policy pick and bclaim() a victim, and hashes the victim
+// under its new identity.  Policies guard their own queues, or
+// like s3fifo and clock rely on bcache.evict and keep hits
+// lock-free.  Counters are per-CPU.
+//
+// Write-back.  bdwrite() marks a buffer B_DELWRI and queues it
+// instead of waiting for the disk.  The bflush kernel thread
+// writes queued buffers back, oldest first, once the oldest has
+// waited BDIRTYAGE ticks or BDIRTYMAX are queued; bflush()
+// writes them all at once for callers that need them on disk,
+// and bflushn() only those of a given set of blocks.
+// A queued buffer stays cached until it has been written, and
+// write-back sorts a batch so that adjacent blocks go to the
+// disk together (see bwritev).
+//
+// bread() times each block it returns with the time-stamp
+// counter and adds the cycles to a log2 histogram for its kind
+// of lookup (LAT_*: M hit, S hit, ghost or cold miss): once for
+// the whole call, disk read included, and once for the wait for
+// the buffer's sleep lock, which shows convoys on hot blocks.
+//
+// Disk I/O is split in two: bsubmit() hands the driver a
+// request and returns, and bwait() sleeps until a set of bufs
+// is in.  bfill() and bwritev() submit every run of a batch
+// before waiting for any, so the disk queue stays full.  A
+// request submitted with a completion function is not waited
+// for; the driver passes each of its bufs to biodone(), which
+// calls the function, as read-ahead does.
+//
+// Events of interest are recorded with TRACE(), which compiles
+// to nothing unless the kernel is built with BTRACE=1.
+//
+// The implementation uses these state flags:
 // * B_VALID: the buffer data has been read from the disk.
-// * B_DIRTY: the buffer data has been modified
-//     and needs to be written to disk.
+// * B_DIRTY: the buffer data needs to be written to disk.
+// * B_ASYNC: the driver hands the request back to biodone().
+// * B_DELWRI: on the delayed-write queue, or being written back.
+// * B_MODIFIED: written by its holder, for the trace.
+// * B_NOREUSE: only read with BH_NOREUSE; let it go first.
+// * B_RAW: a log buffer outside the cache (bgetraw).
+// * B_PINNED: cached for good, outside the policy (bpin).
 
 #include "types.h"
 #include "defs.h"
 #include "param.h"
+#include "mmu.h"
+#include "x86.h"
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
+#include "bcstat.h"
+#include "trace.h"
+#include "bcache.h"
 
-struct
+#ifndef BCPOLICY
+#define BCPOLICY "s3fifo"
+#endif
+
+static struct bpolicy *bpolicies[] = {
+    &lru_policy,
+    &s3fifo_policy,
+    &clock_policy,
+    &twoq_policy,
+    &arc_policy,
+};
+
+// A hash chain and the lock that guards it, alone on a cache line.
+struct bucket
 {
     struct spinlock lock;
-    struct buf mbuf[MBUF];
-    struct buf sbuf[SBUF];
-    struct buf gbuf[GBUF];
+    struct buf *head;
+} __attribute__((aligned(CACHELINE)));
+
+#define BPP (PGSIZE / sizeof(struct bucket)) // buckets per page
+
+struct
+{
+    struct spinlock evict;
+    int nbuf;
+    struct bpolicy *policy;
 
-    // Linked list of all buffers, through prev/next.
-    // head.next is most recently used.
-    struct buf mhead;
-    struct buf shead;
-    struct buf ghead;
+    // nbucket buckets, BPP per page, found through a
+    // directory page.
+    struct bucket **bucket;
+    int nbucket;
 
+    // Delayed writes, oldest first, through dnext.
+    struct spinlock dlock;
+    struct buf *dhead;
+    struct buf *dtail;
+    int nqueued; // on the queue
+    int ndirty;  // B_DELWRI: queued or being written back
+
+    // Buffers holding each class and the most each may hold,
+    // guarded by evict.  During a miss, inclass is the class
+    // coming in; quota is cleared to retry a miss that found
+    // no buffer within its class's quota.
+    int nclass[NBCLASS];
+    int maxclass[NBCLASS];
+    int inclass;
+    int quota;
+
+    // Free raw buffers, through next.
+    struct spinlock rawlock;
+    struct buf *rawfree;
+
+    // Unused buffers of the pinned region, through next;
+    // guarded by evict.
+    struct buf *pinfree;
+
+    // Misses waiting for a buffer to come free, which sleep on
+    // &nwait.  Changed under waitlock, read without it.
+    struct spinlock waitlock;
+    int nwait;
 } bcache;
 
-void print_state()
+struct bcpu bcpus[NCPU];
+
+#define BHIST(f, k, c) do { pushcli(); bhadd(bcpus[cpuid()].st.f[k], c); popcli(); } while(0)
+
+// Count a latency of c cycles in log2 histogram h.
+static void
+bhadd(uint *h, uint c)
+{
+    int i;
+
+    for (i = 0; i < NLAT - 1 && (c >> (i + 1)) != 0; i++)
+        ;
+    h[i]++;
+}
+
+// Lock b for a lookup of kind k, timing the wait.
+static void
+bwaitlock(struct buf *b, int k)
+{
+    uint t = rdtsc();
+
+    acquiresleep(&b->lock);
+    BHIST(lockwait, k, rdtsc() - t);
+}
+
+// The bucket that holds (dev, blockno).
+static struct bucket *
+bbucket(uint dev, uint blockno)
+{
+    uint h = bhash(dev, blockno) % bcache.nbucket;
+
+    return &bcache.bucket[h / BPP][h % BPP];
+}
+
+// Return the buffer holding (dev, blockno), or 0.
+// Caller must hold the bucket's lock.
+static struct buf *
+hlookup(struct bucket *bk, uint dev, uint blockno)
 {
     struct buf *b;
-    cprintf("\nM: ");
-    for (b = &bcache.mhead; b->next != &bcache.mhead; b = b->next)
+
+    for (b = bk->head; b != 0; b = b->hnext)
     {
-        cprintf("%d --", b->next->blockno);
+        if (b->dev == dev && b->blockno == blockno)
+            return b;
     }
-    cprintf("\nS: ");
-    for (b = &bcache.shead; b->next != &bcache.shead; b = b->next)
+    return 0;
+}
+
+// Index b under its current (dev, blockno).
+// Caller must hold the bucket's lock.
+static void
+hinsert(struct bucket *bk, struct buf *b)
+{
+    b->hnext = bk->head;
+    bk->head = b;
+}
+
+// Drop b from the index; a no-op if b is not indexed.
+// Caller must hold the bucket's lock.
+static void
+hremove(struct bucket *bk, struct buf *b)
+{
+    struct buf **pp;
+
+    for (pp = &bk->head; *pp != 0; pp = &(*pp)->hnext)
+    {
+        if (*pp == b)
+        {
+            *pp = b->hnext;
+            b->hnext = 0;
+            return;
+        }
+    }
+}
+
+// Take b for another block if nobody is using it: b must be
+// unreferenced and clean, and the class coming in must be
+// under its quota unless b is of that class.  On success b is
+// unhashed, so lookups of its old block miss, and holds the one
+// reference.
+// Only policy alloc hooks call this, with bcache.evict held.
+int bclaim(struct buf *b)
+{
+    struct bucket *bk;
+    int ok, c = bcache.inclass;
+
+    if (bcache.quota && b->bclass != c && b->bclass != BC_NONE &&
+        bcache.nclass[c] >= bcache.maxclass[c])
+        return 0;
+
+    bk = bbucket(b->dev, b->blockno);
+    acquire(&bk->lock);
+    ok = b->refcnt == 0 && (b->flags & (B_DIRTY | B_DELWRI)) == 0;
+    if (ok)
     {
-        cprintf("%d --", b->next->blockno);
+        hremove(bk, b);
+        b->refcnt = 1;
+        bcache.nclass[b->bclass]--;
+        b->bclass = BC_NONE;
     }
-    cprintf("\nG: ");
-    for (b = &bcache.ghead; b->next != &bcache.ghead; b = b->next)
+    else if (b->refcnt == 0)
+        BCOUNT(dirtyskips);
+    release(&bk->lock);
+    return ok;
+}
+
+// The policy named name, or 0.
+static struct bpolicy *
+bpolicy(char *name)
+{
+    int i;
+
+    for (i = 0; i < NELEM(bpolicies); i++)
     {
-        cprintf("%d --", b->next->blockno);
+        if (strncmp(bpolicies[i]->name, name, 16) == 0)
+            return bpolicies[i];
     }
-    cprintf("\n");
+    return 0;
+}
+
+// A zeroed page for cache bookkeeping, which lives as long
+// as the kernel.
+void *
+bpage(void)
+{
+    char *p;
+
+    if ((p = kalloc()) == 0)
+        panic("bpage");
+    memset(p, 0, PGSIZE);
+    return p;
 }
-static struct buf *insert(uint blockno, uint dev);
 
 void binit(void)
 {
-    struct buf *b;
+    struct buf *b, list;
+    char name[16], *p;
+    int i, n, frac, small, data, adapt;
 
-    initlock(&bcache.lock, "bcache");
+    initlock(&bcache.evict, "bcache.evict");
+    initlock(&bcache.dlock, "bcache.dirty");
+    initlock(&bcache.rawlock, "bcache.raw");
+    initlock(&bcache.waitlock, "bcache.wait");
 
-    // Create linked list of buffers for mbuf
-    bcache.mhead.prev = &bcache.mhead;
-    bcache.mhead.next = &bcache.mhead;
-    for (b = bcache.mbuf; b < bcache.mbuf + MBUF; b++)
+    bcache.policy = bpolicy(BCPOLICY);
+    if (bootparam("opt/xv6/bcpolicy", name, sizeof(name)) >= 0)
     {
-        b->next = bcache.mhead.next;
-        b->prev = &bcache.mhead;
-        b->buf_type = 0;
-        initsleeplock(&b->lock, "mbuffer");
-        bcache.mhead.next->prev = b;
-        bcache.mhead.next = b;
+        if (bpolicy(name) != 0)
+            bcache.policy = bpolicy(name);
+        else
+            cprintf("binit: unknown policy %s\n", name);
     }
+    if (bcache.policy == 0)
+        panic("binit: no policy");
 
-    // Create linked list of buffers for gbuf
-    bcache.shead.prev = &bcache.shead;
-    bcache.shead.next = &bcache.shead;
-    for (b = bcache.sbuf; b < bcache.sbuf + SBUF; b++)
+    frac = bootparamint("opt/xv6/bcfrac", BCFRAC);
+    if (frac <= 0)
+        frac = BCFRAC;
+    small = bootparamint("opt/xv6/bcsmall", BCSMALL);
+    if (small > 100)
+        small = BCSMALL;
+    adapt = bootparamint("opt/xv6/bcadapt", BCADAPT) != 0;
+    data = bootparamint("opt/xv6/bcdata", BCDATA);
+    if (data <= 0 || data > 100)
+        data = BCDATA;
+
+    n = kfreepages() / frac * (PGSIZE / sizeof(struct buf));
+    if (n < NBUF)
+        n = NBUF;
+    if (n > FSSIZE)
+        n = FSSIZE;
+
+    // The cache's buffers, then the raw and pinned ones.
+    linit(&list);
+    p = 0;
+    for (i = 0; i < n + LOGSIZE + NPIN; i++)
     {
-        b->next = bcache.shead.next;
-        b->prev = &bcache.shead;
-        b->buf_type = 1;
-        initsleeplock(&b->lock, "sbuffer");
-        bcache.shead.next->prev = b;
-        bcache.shead.next = b;
+        if (i % (PGSIZE / sizeof(struct buf)) == 0)
+            p = bpage();
+        b = (struct buf *)p + i % (PGSIZE / sizeof(struct buf));
+        initsleeplock(&b->lock, "buffer");
+        if (i < n)
+            lpush(&list, b);
+        else if (i < n + LOGSIZE)
+        {
+            b->next = bcache.rawfree;
+            bcache.rawfree = b;
+        }
+        else
+        {
+            b->next = bcache.pinfree;
+            bcache.pinfree = b;
+        }
     }
+    bcache.nbuf = n;
+    bcache.nclass[BC_NONE] = n;
+    bcache.maxclass[BC_NONE] = n;
+    bcache.maxclass[BC_META] = n;
+    bcache.maxclass[BC_DATA] = n * data / 100 > 0 ? n * data / 100 : 1;
 
-    // Create linked list of buffers for gbuf
-    bcache.ghead.prev = &bcache.ghead;
-    bcache.ghead.next = &bcache.ghead;
-    for (b = bcache.gbuf; b < bcache.gbuf + GBUF; b++)
+    // About two buffers a bucket, in whole pages.
+    bcache.bucket = bpage();
+    for (i = 0; i * BPP < n / 2 || i == 0; i++)
     {
-        b->next = bcache.ghead.next;
-        b->prev = &bcache.ghead;
-        b->buf_type = 2;
-        initsleeplock(&b->lock, "gbuffer");
-        bcache.ghead.next->prev = b;
-        bcache.ghead.next = b;
+        if (i == PGSIZE / sizeof(struct bucket *))
+            break;
+        bcache.bucket[i] = bpage();
     }
+    bcache.nbucket = i * BPP;
+    for (i = 0; i < bcache.nbucket; i++)
+        initlock(&bcache.bucket[i / BPP][i % BPP].lock, "bcache.bucket");
+
+    bcache.policy->init(&list, n, n * small / 100, adapt);
+    cprintf("bcache: %d buffers (%d KB), %s, %d%% small%s, %d%% data\n",
+            n, n * BSIZE / 1024, bcache.policy->name, small,
+            adapt ? " to start" : "", data);
 }
 
-// Look through buffer cache for block on device dev.
-// If not found, allocate a buffer.
-// In either case, return locked buffer.
+// A buffer may have become free to recycle: wake the misses
+// waiting for one.  bget() counts itself in nwait before its
+// last look at the buffers, and we look at nwait after b's
+// refcnt or flags changed, so one of the two sees the other.
+static void
+bfreed(void)
+{
+    if (bcache.nwait == 0)
+        return;
+    acquire(&bcache.waitlock);
+    wakeup(&bcache.nwait);
+    release(&bcache.waitlock);
+}
+
+// Drop a reference to b.
+// The policy hears when the last reference goes.
+static void
+bunref(struct buf *b)
+{
+    struct bucket *bk;
+    int last;
+
+    // Our reference keeps b's identity, and so its bucket, fixed.
+    bk = bbucket(b->dev, b->blockno);
+    acquire(&bk->lock);
+    b->refcnt--;
+    last = b->refcnt == 0;
+    release(&bk->lock);
+    if (last)
+    {
+        bcache.policy->release(b);
+        bfreed();
+    }
+}
+
+// Return (dev, blockno) from this CPU's front cache, locked, or 0.
+// Sets *kind to the kind of hit.
 static struct buf *
-bget(uint dev, uint blockno)
+bfront(uint dev, uint blockno, int *kind)
+{
+    struct buf **slot, *b;
+
+    pushcli();
+    slot = &bcpus[cpuid()].front[bhash(dev, blockno) % NFRONT];
+    b = (struct buf *)xchg((uint *)slot, 0);
+    if (b != 0 && (b->dev != dev || b->blockno != blockno))
+    {
+        // Another block's: put it back.  Only this CPU fills
+        // the slot, so it is still empty.
+        xchg((uint *)slot, (uint)b);
+        b = 0;
+    }
+    popcli();
+    if (b == 0)
+        return 0;
+
+    // The slot's reference is now ours.
+    b->fhit = 1;
+    if (b->bclass == BC_META)
+        BCOUNT(metahits);
+    BCOUNT(fronthits);
+    TRACE(TR_HIT, b->dev, b->blockno, b->buf_type);
+    *kind = b->buf_type == BQ_M ? LAT_MHIT : LAT_SHIT;
+    bwaitlock(b, *kind);
+    return b;
+}
+
+// Drop the reference b held in a front cache.
+static void
+bunfront(struct buf *b)
+{
+    if (b->fhit)
+    {
+        b->fhit = 0;
+        bcache.policy->hit(b);
+    }
+    bunref(b);
+}
+
+// Keep b, just released, and its reference in this CPU's front
+// cache, releasing the buffer it displaces.
+static void
+bstash(struct buf *b)
+{
+    struct buf **slot, *old;
+
+    pushcli();
+    slot = &bcpus[cpuid()].front[bhash(b->dev, b->blockno) % NFRONT];
+    old = (struct buf *)xchg((uint *)slot, (uint)b);
+    popcli();
+    if (old != 0)
+        bunfront(old);
+}
+
+// Empty every CPU's front cache.  Returns the number of buffers
+// released.
+static int
+bdrain(void)
 {
-    cprintf("in bget\n");
-    print_state();
     struct buf *b;
+    int i, j, n = 0;
 
-    acquire(&bcache.lock);
-    // Is the block already cached?
-    for (b = bcache.mhead.next; b != &bcache.mhead; b = b->next)
+    for (i = 0; i < NCPU; i++)
     {
-        if (b->dev == dev && b->blockno == blockno)
+        for (j = 0; j < NFRONT; j++)
         {
-            b->refcnt++;
-            release(&bcache.lock);
-            acquiresleep(&b->lock);
-            cprintf("Block already cached: %d\n", blockno);
-            return b;
+            if ((b = (struct buf *)xchg((uint *)&bcpus[i].front[j], 0)) != 0)
+            {
+                bunfront(b);
+                n++;
+            }
         }
     }
-    for (b = bcache.shead.next; b != &bcache.shead; b = b->next)
+    return n;
+}
+
+// Found b, which is in bucket bk, for a lookup.
+// Takes a reference and releases bk; sets *kind to the kind
+// of hit.
+static struct buf *
+bhit(struct bucket *bk, struct buf *b, int *kind)
+{
+    b->refcnt++;
+    release(&bk->lock);
+    if (b->bclass == BC_META)
+        BCOUNT(metahits);
+    if (b->flags & B_PINNED)
+        BCOUNT(pinhits);
+    else
     {
-        if (b->dev == dev && b->blockno == blockno)
-        {
-            b->refcnt++;
-            release(&bcache.lock);
-            acquiresleep(&b->lock);
-            cprintf("Block already cached: %d\n", blockno);
-            return b;
-        }
+        if (b->buf_type == BQ_M)
+            BCOUNT(mhits);
+        else
+            BCOUNT(shits);
+        bcache.policy->hit(b);
     }
-    // b->blockno = blockno;
-    // b->dev = dev;
-    // b->refcnt += 1;
-    // b->flags = 0;
-    // release(&bcache.lock);
-    // acquiresleep(&b->lock);
-    // cprintf("No error yet\n");
-    // return b;
-    release(&bcache.lock);
-    return insert(dev, blockno);
-    panic("bget: no buffers");
+    TRACE(TR_HIT, b->dev, b->blockno, b->buf_type);
+    *kind = b->buf_type == BQ_M ? LAT_MHIT : LAT_SHIT;
+    bwaitlock(b, *kind);
+    return b;
 }
 
+// Let the policy choose, and claim, a buffer to recycle for
+// a block of class c, or return 0 if every buffer is busy.
+// A refused attempt leaves the policy's history of the block
+// alone, so the retry over quota still sees a ghost hit.
+// Caller must hold bcache.evict.
 static struct buf *
-insert(uint dev, uint blockno)
+bvictim(uint dev, uint blockno, int hint, int c)
 {
-    cprintf("In insert: dev: %d, blockno: %d\n", dev, blockno);
     struct buf *b;
-    // try to put in main
-    acquire(&bcache.lock);
-    for (b = bcache.mhead.prev; b != &bcache.mhead; b = b->prev)
+
+    bcache.inclass = c;
+    bcache.quota = 1;
+    if ((b = bcache.policy->alloc(dev, blockno, hint)) == 0)
     {
-        if (b->refcnt == 0 && (b->flags & B_DIRTY) == 0)
+        // Every buffer of this class is busy: go over quota.
+        bcache.quota = 0;
+        b = bcache.policy->alloc(dev, blockno, hint);
+    }
+    return b;
+}
+
+// Look through buffer cache for block on device dev.
+// If not found, allocate a buffer, waiting for one to come
+// free if all are in use.
+// In either case, return locked buffer, and set *kind to the
+// kind of lookup (LAT_*).
+// With BH_PREFETCH in hint, the caller only wants the block
+// brought in: return 0 if it is cached or no buffer is free.
+// With BH_NOWAIT, return 0 rather than wait for a free buffer.
+static struct buf *
+bget(uint dev, uint blockno, int hint, int *kind)
+{
+    struct bucket *bk = bbucket(dev, blockno);
+    struct buf *b;
+    uint ghits, t0 = 0;
+    int waited = 0;
+    int c = hint & BH_META ? BC_META : BC_DATA;
+
+    // Did this CPU release it just now?
+    if ((hint & BH_PREFETCH) == 0 && (b = bfront(dev, blockno, kind)) != 0)
+        return b;
+
+    // Is the block already cached?
+    acquire(&bk->lock);
+    if ((b = hlookup(bk, dev, blockno)) != 0)
+    {
+        if (hint & BH_PREFETCH)
         {
-            b->dev = dev;
-            b->blockno = blockno;
-            b->flags = 0;
-            b->refcnt = 1;
-            b->prev->next = b->next;
-            b->next->prev = b->prev;
-
-            // Move to head
-            b->next = bcache.mhead.next;
-            b->prev = &bcache.mhead;
-            bcache.mhead.next->prev = b;
-            bcache.mhead.next = b;
-            release(&bcache.lock);
-            acquiresleep(&b->lock);
-            cprintf("Block not cached, newly allocated into MAIN buffer: %d\n", blockno);
-            return b;
+            release(&bk->lock);
+            return 0;
         }
+        return bhit(bk, b, kind);
     }
+    release(&bk->lock);
 
-    cprintf("not space in mhead\n");
-    for (b = bcache.shead.prev; b != &bcache.shead; b = b->prev)
+    // Not cached.  Only one miss at a time replaces a block;
+    // another may have brought this one in while we waited.
+    acquire(&bcache.evict);
+    for (;;)
     {
-        cprintf("heyyyyyyy");
-        if (b->refcnt == 0 && (b->flags & B_DIRTY) == 0)
+        acquire(&bk->lock);
+        if ((b = hlookup(bk, dev, blockno)) != 0)
         {
-            b->dev = dev;
-            b->blockno = blockno;
-            b->flags = 0;
-            b->refcnt = 1;
-            b->prev->next = b->next;
-            b->next->prev = b->prev;
-
-            // Move to head
-            b->next = bcache.shead.next;
-            b->prev = &bcache.shead;
-            bcache.shead.next->prev = b;
-            bcache.shead.next = b;
-            release(&bcache.lock);
-            acquiresleep(&b->lock);
-            cprintf("Block not cached, newly allocated into buffer: %d\n", blockno);
-            return b;
+            release(&bcache.evict);
+            if (hint & BH_PREFETCH)
+            {
+                release(&bk->lock);
+                return 0;
+            }
+            return bhit(bk, b, kind);
+        }
+        release(&bk->lock);
+
+        // bcache.evict keeps us on this CPU, and so on its counters.
+        ghits = bcpus[cpuid()].st.ghits;
+        if ((b = bvictim(dev, blockno, hint, c)) != 0 || (hint & BH_PREFETCH))
+            break;
+        if (bdrain() > 0)
+            continue;
+        if (hint & BH_NOWAIT)
+            break;
+
+        // Every buffer is in use or dirty.  Count ourselves in
+        // nwait, look once more and sleep until bfreed().
+        acquire(&bcache.waitlock);
+        bcache.nwait++;
+        if ((b = bvictim(dev, blockno, hint, c)) == 0)
+        {
+            if (!waited)
+            {
+                waited = 1;
+                BCOUNT(allocwaits);
+                t0 = ticks;
+            }
+            release(&bcache.evict);
+            sleep(&bcache.nwait, &bcache.waitlock);
         }
+        bcache.nwait--;
+        release(&bcache.waitlock);
+        if (b != 0)
+            break;
+        acquire(&bcache.evict);
     }
-    // try to put in small
-    uint found_in_g = 0;
-    for (b = bcache.ghead.next; !found_in_g && b != &bcache.ghead; b = b->next)
+    if (waited)
+        bcpus[cpuid()].st.waitticks += ticks - t0;
+    if (b == 0)
     {
-        cprintf("dev: %d bno: %d needed: %d %d found_in_g: %d\n", b->dev, b->blockno, dev, blockno, found_in_g);
-        if (b->dev == dev && b->blockno == blockno)
+        release(&bcache.evict);
+        return 0;
+    }
+    if (hint & BH_PREFETCH)
+        BCOUNT(prefetches);
+    else
+    {
+        BCOUNT(misses);
+        if (c == BC_META)
+            BCOUNT(metamisses);
+        *kind = bcpus[cpuid()].st.ghits != ghits ? LAT_GMISS : LAT_MISS;
+        TRACE(TR_MISS, dev, blockno, *kind == LAT_GMISS);
+    }
+    if (b->flags & B_VALID)
+    {
+        BCOUNT(evictions);
+        TRACE(TR_EVICT, b->dev, b->blockno, b->buf_type);
+    }
+    b->dev = dev;
+    b->blockno = blockno;
+    b->flags = hint & BH_NOREUSE ? B_NOREUSE : 0;
+    b->bclass = c;
+    bcache.nclass[c]++;
+    acquire(&bk->lock);
+    hinsert(bk, b);
+    release(&bk->lock);
+    release(&bcache.evict);
+    if (hint & BH_PREFETCH)
+        acquiresleep(&b->lock);
+    else
+        bwaitlock(b, *kind);
+    return b;
+}
+
+// Start the disk request for locked buf b and the bufs chained
+// to it through cnext, and return without waiting.  With done
+// 0, the caller waits for them with bwait(); otherwise the
+// request is the driver's until it calls biodone() on each buf,
+// which passes it to done.
+void bsubmit(struct buf *b, void (*done)(struct buf *))
+{
+    struct buf *c;
+
+    if (done)
+    {
+        for (c = b; c != 0; c = c->cnext)
         {
-            found_in_g = 1;
+            c->iodone = done;
+            c->flags |= B_ASYNC;
         }
     }
-    if (found_in_g == 1)
+    idesubmit(b);
+}
+
+// Wait until the disk requests of the n locked bufs, submitted
+// without a completion function, are all done.  Each buf's
+// cnext chain is cut once it is in.
+void bwait(struct buf **bufs, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+        ideiowait(bufs[i]);
+    for (i = 0; i < n; i++)
+        bufs[i]->cnext = 0;
+}
+
+// Read those of the n locked bufs, holding consecutive blocks,
+// that are not valid; each run of them goes to the disk as one
+// request, all runs before waiting for any.  If done is not 0
+// the requests are only started, and done gets each buf when
+// it is in.
+static void
+bfill(struct buf **bufs, int n, void (*done)(struct buf *))
+{
+    int i, j, k;
+
+    for (i = 0; i < n; i = j)
     {
-        // Insert into M
-        cprintf("found in g\n");
-        // acquire(&bcache.lock);
-        b = bcache.mhead.prev;
-        b->dev = dev;
-        b->blockno = blockno;
-        b->flags = 0;
-        b->refcnt = 1;
-        b->prev->next = b->next;
-        b->next->prev = b->prev;
-
-        // Move to head
-        b->next = bcache.mhead.next;
-        b->prev = &bcache.mhead;
-        bcache.mhead.next->prev = b;
-        bcache.mhead.next = b;
-        release(&bcache.lock);
-        acquiresleep(&b->lock);
-        print_state();
-        return b;
+        if (bufs[i]->flags & B_VALID)
+        {
+            // Read by someone else since bget() hashed it.
+            if (done)
+                done(bufs[i]);
+            j = i + 1;
+            continue;
+        }
+        for (j = i + 1; j < n && (bufs[j]->flags & B_VALID) == 0; j++)
+            ;
+        for (k = i; k < j; k++)
+        {
+            bufs[k]->cnext = k + 1 < j ? bufs[k + 1] : 0;
+            BCOUNT(reads);
+            if (done)
+                TRACE(TR_PREFETCH, bufs[k]->dev, bufs[k]->blockno, 0);
+            else
+                TRACE(TR_READ, bufs[k]->dev, bufs[k]->blockno, 1);
+        }
+        BCOUNT(rreqs);
+        bsubmit(bufs[i], done);
     }
-    else
+    if (!done)
+        bwait(bufs, n);
+}
+
+// Return a locked buffer for (dev, blockno) that is not in the
+// cache, for the log's blocks.  Its contents are not valid; it
+// can be read by breadn() or filled in and written with
+// bwrite() or bwritev(), and is given back with brelse().
+struct buf *
+bgetraw(uint dev, uint blockno)
+{
+    struct buf *b;
+
+    acquire(&bcache.rawlock);
+    while ((b = bcache.rawfree) == 0)
+        sleep(&bcache.rawfree, &bcache.rawlock);
+    bcache.rawfree = b->next;
+    release(&bcache.rawlock);
+
+    acquiresleep(&b->lock);
+    b->dev = dev;
+    b->blockno = blockno;
+    b->flags = B_RAW;
+    return b;
+}
+
+// Return in bufs locked bufs with the contents of the n
+// consecutive blocks starting at blockno, n at most MAXRUN,
+// and return how many there are.  Blocks not cached are read
+// with one disk request per run.  Only the first block may wait
+// for a free buffer, since the caller holds the ones before
+// it: when no buffer is free the run stops short, at one block
+// at least.  hint holds BH_ flags; with BH_LOG the bufs come
+// from bgetraw() and are always read, all n of them.
+int breadn(uint dev, uint blockno, int n, struct buf **bufs, int hint)
+{
+    int i, kind[MAXRUN];
+    uint t;
+
+    if (n < 1 || n > MAXRUN)
+        panic("breadn");
+    hint &= ~(BH_PREFETCH | BH_NOWAIT);
+    t = rdtsc();
+    for (i = 0; i < n; i++)
     {
-        //
-        cprintf("not found in g\n");
-        // acquire(&bcache.lock);
-        b = bcache.shead.prev;
-        if (b->refcnt > 1)
+        if (hint & BH_LOG)
         {
-            // put into ghost
-            struct buf *b1 = bcache.ghead.prev;
-            b1->dev = b->dev;
-            b1->blockno = b->dev;
-            b1->refcnt = b->refcnt;
-            b1->flags = b->flags;
-            b1->prev->next = b1->next;
-            b1->next->prev = b1->prev;
-
-            // Move to head
-            b1->next = bcache.ghead.next;
-            b1->prev = &bcache.ghead;
-            bcache.ghead.next->prev = b1;
-            bcache.ghead.next = b1;
+            bufs[i] = bgetraw(dev, blockno + i);
+            continue;
         }
-        b->dev = dev;
-        b->blockno = blockno;
-        b->flags = 0;
-        b->refcnt = 1;
-        b->prev->next = b->next;
-        b->next->prev = b->prev;
-
-        // Move to head
-        b->next = bcache.shead.next;
-        b->prev = &bcache.shead;
-        bcache.shead.next->prev = b;
-        bcache.shead.next = b;
-        release(&bcache.lock);
-        acquiresleep(&b->lock);
-        print_state();
-        return b;
+        if ((bufs[i] = bget(dev, blockno + i, i > 0 ? hint | BH_NOWAIT : hint, &kind[i])) == 0)
+            break;
+        if ((hint & BH_NOREUSE) == 0)
+            bufs[i]->flags &= ~B_NOREUSE; // wanted after all
+        if (bufs[i]->flags & B_VALID)
+            TRACE(TR_READ, dev, blockno + i, 0);
     }
+    n = i;
+    bfill(bufs, n, 0);
+
+    // Every block of a run is in when the last one is.
+    if ((hint & BH_LOG) == 0)
+    {
+        t = rdtsc() - t;
+        for (i = 0; i < n; i++)
+            BHIST(lat, kind[i], t);
+    }
+    return n;
 }
 
 // Return a locked buf with the contents of the indicated block.
+// hint holds BH_ flags, at least the block's class.
 struct buf *
-bread(uint dev, uint blockno)
+bread(uint dev, uint blockno, int hint)
 {
     struct buf *b;
 
-    b = bget(dev, blockno);
-    if ((b->flags & B_VALID) == 0)
+    breadn(dev, blockno, 1, &b, hint);
+    return b;
+}
+
+// A read-ahead request is in: drop the lock and reference that
+// bprefetch() left for the buf.  Not brelse(): read-ahead is
+// not an access.
+static void
+bprefetchdone(struct buf *b)
+{
+    releasesleep(&b->lock);
+    bunref(b);
+}
+
+// Start reading the n blocks from blockno, n at most MAXRUN,
+// into the cache without waiting for them.  Blocks already
+// cached are skipped; the rest go to the disk in runs.  Each
+// buffer stays locked until its read finishes, so a bread() of
+// the block meanwhile sleeps until the data is in.  hint holds
+// BH_ flags.
+void bprefetch(uint dev, uint blockno, int n, int hint)
+{
+    struct buf *run[MAXRUN];
+    int i, m, kind;
+
+    if (n > MAXRUN)
+        panic("bprefetch");
+    m = 0;
+    for (i = 0; i < n; i++)
     {
-        iderw(b);
+        if ((run[m] = bget(dev, blockno + i, hint | BH_PREFETCH, &kind)) != 0)
+            m++;
+        else
+        {
+            bfill(run, m, bprefetchdone);
+            m = 0;
+        }
     }
-    cprintf("bread\n");
-    return b;
+    bfill(run, m, bprefetchdone);
+}
+
+// Read (dev, blockno) into a buffer of the pinned region, to
+// stay cached for good outside the replacement policy.  Must be
+// called before anything reads the block: returns -1 if it is
+// already cached or the region is full.
+int bpin(uint dev, uint blockno)
+{
+    struct bucket *bk = bbucket(dev, blockno);
+    struct buf *b;
+
+    acquire(&bcache.evict);
+    acquire(&bk->lock);
+    if ((b = bcache.pinfree) == 0 || hlookup(bk, dev, blockno) != 0)
+    {
+        release(&bk->lock);
+        release(&bcache.evict);
+        return -1;
+    }
+    bcache.pinfree = b->next;
+    b->dev = dev;
+    b->blockno = blockno;
+    b->flags = B_PINNED;
+    b->bclass = BC_META;
+    b->refcnt = 2; // one that is never dropped, and ours
+    hinsert(bk, b);
+    release(&bk->lock);
+    release(&bcache.evict);
+
+    acquiresleep(&b->lock);
+    bfill(&b, 1, 0);
+    releasesleep(&b->lock);
+    bunref(b);
+    return 0;
+}
+
+// Record up to NHOT of dev's blocks now in M in block hot of
+// dev, for bprewarm() at the next boot.
+void bhotsave(uint dev, uint hot)
+{
+    struct bucket *bk;
+    struct buf *hb, *b;
+    struct hotset *hs;
+    int i;
+
+    hb = bgetraw(dev, hot);
+    memset(hb->data, 0, BSIZE);
+    hs = (struct hotset *)hb->data;
+    hs->magic = HOTMAGIC;
+    for (i = 0; i < bcache.nbucket && hs->n < NHOT; i++)
+    {
+        bk = &bcache.bucket[i / BPP][i % BPP];
+        acquire(&bk->lock);
+        for (b = bk->head; b != 0 && hs->n < NHOT; b = b->hnext)
+        {
+            if (b->dev != dev || b->buf_type != BQ_M || (b->flags & (B_VALID | B_PINNED)) != B_VALID)
+                continue;
+            hs->blockno[hs->n++] = b->blockno | (b->bclass == BC_META ? HOTMETA : 0);
+        }
+        release(&bk->lock);
+    }
+    bwrite(hb);
+    brelse(hb);
+}
+
+// Start reading the blocks that bhotsave() recorded in block
+// hot of dev, sorted so that adjacent blocks of one class go to
+// the disk together.  Blocks at or past size are ignored.
+// The log must have been recovered: a block read before its
+// committed copy is installed would be cached stale.
+void bprewarm(uint dev, uint hot, uint size)
+{
+    struct buf *hb;
+    struct hotset *hs;
+    uint *bn, x, start;
+    int i, j, hint;
+
+    hb = bread(dev, hot, BH_LOG);
+    hs = (struct hotset *)hb->data;
+    bn = hs->blockno;
+    if (hs->magic != HOTMAGIC || hs->n > NHOT)
+    {
+        brelse(hb);
+        return;
+    }
+    for (i = 1; i < hs->n; i++)
+    {
+        x = bn[i];
+        for (j = i; j > 0 && (bn[j - 1] & ~HOTMETA) > (x & ~HOTMETA); j--)
+            bn[j] = bn[j - 1];
+        bn[j] = x;
+    }
+    for (i = 0; i < hs->n; i = j)
+    {
+        start = bn[i] & ~HOTMETA;
+        for (j = i + 1; j < hs->n && j - i < MAXRUN && bn[j] == bn[i] + (j - i); j++)
+            ;
+        hint = (bn[i] & HOTMETA ? BH_META : BH_DATA) | BH_WARM;
+        if (start + (j - i) <= size)
+            bprefetch(dev, start, j - i, hint);
+    }
+    brelse(hb);
 }
 
 // Write b's contents to disk.  Must be locked.
@@ -305,23 +984,325 @@ void bwrite(struct buf *b)
 {
     if (!holdingsleep(&b->lock))
         panic("bwrite");
-    b->flags |= B_DIRTY;
-    iderw(b);
-    cprintf("bwrite\n");
+    b->flags |= B_DIRTY | B_MODIFIED;
+    bsubmit(b, 0);
+    bwait(&b, 1);
+    BCOUNT(writes);
+    BCOUNT(wreqs);
+    TRACE(TR_WRITE, b->dev, b->blockno, 1);
+}
+
+// Write the n locked buffers in bufs, sorted by (dev, blockno),
+// to disk.  Runs of adjacent blocks, up to MAXRUN of them, go
+// to the disk as one request; all runs are submitted before
+// waiting for any.
+void bwritev(struct buf **bufs, int n)
+{
+    int i, j, k;
+
+    for (i = 0; i < n; i = j)
+    {
+        for (j = i + 1; j < n && j - i < MAXRUN; j++)
+        {
+            if (bufs[j]->dev != bufs[i]->dev || bufs[j]->blockno != bufs[i]->blockno + (j - i))
+                break;
+        }
+        for (k = i; k < j; k++)
+        {
+            if (!holdingsleep(&bufs[k]->lock))
+                panic("bwritev");
+            bufs[k]->flags |= B_DIRTY | B_MODIFIED;
+            bufs[k]->cnext = k + 1 < j ? bufs[k + 1] : 0;
+            BCOUNT(writes);
+            TRACE(TR_WRITE, bufs[k]->dev, bufs[k]->blockno, j - i);
+        }
+        bsubmit(bufs[i], 0);
+        BCOUNT(wreqs);
+    }
+    bwait(bufs, n);
+}
+
+// Mark b, which must be locked, to be written to disk later,
+// so the caller need not wait for it.
+void bdwrite(struct buf *b)
+{
+    if (!holdingsleep(&b->lock) || (b->flags & B_RAW))
+        panic("bdwrite");
+    b->flags |= B_DIRTY | B_MODIFIED;
+    if (b->flags & B_DELWRI)
+        return; // still queued, or the write-back will wait for us
+    b->flags |= B_DELWRI;
+    acquire(&bcache.dlock);
+    b->dtick = ticks;
+    b->dnext = 0;
+    if (bcache.dtail)
+        bcache.dtail->dnext = b;
+    else
+        bcache.dhead = b;
+    bcache.dtail = b;
+    bcache.nqueued++;
+    bcache.ndirty++;
+    release(&bcache.dlock);
+}
+
+// Take up to n of the oldest delayed writes off the queue.
+// Caller must hold bcache.dlock.
+static int
+btake(struct buf **bufs, int n)
+{
+    int i;
+
+    for (i = 0; i < n && bcache.dhead != 0; i++)
+    {
+        bufs[i] = bcache.dhead;
+        bcache.dhead = bcache.dhead->dnext;
+    }
+    if (bcache.dhead == 0)
+        bcache.dtail = 0;
+    bcache.nqueued -= i;
+    return i;
+}
+
+#define NFLUSH 32 // delayed writes handled at a time
+
+// Write back the delayed writes in bufs, at most NFLUSH, taken
+// by btake().
+static void
+bwriteback(struct buf **bufs, int n)
+{
+    struct buf *b, *w[NFLUSH];
+    int i, j, k, m;
+
+    // Sort by block so that adjacent blocks share a request.
+    for (i = 1; i < n; i++)
+    {
+        b = bufs[i];
+        for (j = i; j > 0 && (bufs[j - 1]->dev > b->dev ||
+                              (bufs[j - 1]->dev == b->dev && bufs[j - 1]->blockno > b->blockno));
+             j--)
+            bufs[j] = bufs[j - 1];
+        bufs[j] = b;
+    }
+
+    // The buffers' B_DELWRI keeps them from being recycled,
+    // so no reference is needed to lock them.  Never wait for
+    // one while holding another: their holders take buffers in
+    // no particular order (readi() holds data blocks while
+    // bmap() reads an indirect one).  So only the first of a
+    // group is waited for, and a busy buffer after it ends the
+    // group, which is written and unlocked before it is.
+    for (i = 0; i < n; i = j)
+    {
+        acquiresleep(&bufs[i]->lock);
+        for (j = i + 1; j < n && tryacquiresleep(&bufs[j]->lock); j++)
+            ;
+        m = 0;
+        for (k = i; k < j; k++)
+        {
+            if (bufs[k]->flags & B_DIRTY)
+                w[m++] = bufs[k];
+        }
+        bwritev(w, m);
+        for (k = i; k < j; k++)
+        {
+            bufs[k]->flags &= ~(B_DELWRI | B_MODIFIED); // not an access
+            releasesleep(&bufs[k]->lock);
+        }
+    }
+    acquire(&bcache.dlock);
+    bcache.ndirty -= n;
+    wakeup(&bcache.ndirty);
+    release(&bcache.dlock);
+    bfreed();
+}
+
+// Must the flusher write back now?  Caller must hold bcache.dlock.
+static int
+bdue(void)
+{
+    if (bcache.dhead == 0)
+        return 0;
+    return bcache.nqueued >= BDIRTYMAX || bcache.nwait > 0 ||
+           ticks - bcache.dhead->dtick >= BDIRTYAGE;
+}
+
+// The bflush kernel thread.  It checks every tick whether the
+// delayed writes have grown too many or too old.
+static void
+bflusher(void)
+{
+    struct buf *bufs[NFLUSH];
+    int n;
+
+    acquire(&bcache.dlock);
+    for (;;)
+    {
+        while (!bdue())
+            sleep(&ticks, &bcache.dlock);
+        n = btake(bufs, NFLUSH);
+        release(&bcache.dlock);
+        bwriteback(bufs, n);
+        acquire(&bcache.dlock);
+    }
+}
+
+void bflushinit(void)
+{
+    kthread("bflush", bflusher);
+}
+
+// Write back every delayed write, and return once all of them,
+// including any the flusher is writing, are on disk.
+void bflush(void)
+{
+    struct buf *bufs[NFLUSH];
+    int n;
+
+    acquire(&bcache.dlock);
+    while (bcache.ndirty > 0)
+    {
+        if ((n = btake(bufs, NFLUSH)) == 0)
+        {
+            // The flusher has the rest in hand.
+            sleep(&bcache.ndirty, &bcache.dlock);
+            continue;
+        }
+        release(&bcache.dlock);
+        bwriteback(bufs, n);
+        acquire(&bcache.dlock);
+    }
+    release(&bcache.dlock);
+}
+
+// Is (dev, blockno) cached and waiting for write-back?
+static int
+bdelwri(uint dev, uint blockno)
+{
+    struct bucket *bk = bbucket(dev, blockno);
+    struct buf *b;
+    int d;
+
+    acquire(&bk->lock);
+    b = hlookup(bk, dev, blockno);
+    d = b != 0 && (b->flags & B_DELWRI);
+    release(&bk->lock);
+    return d;
+}
+
+// Write back the delayed writes of the n blocks of dev in
+// blocknos, and return once they are on disk.  The other delayed
+// writes are left to the flusher.
+void bflushn(uint dev, int *blocknos, int n)
+{
+    struct buf *bufs[NFLUSH], *b, *prev, **pp;
+    int i, m;
+
+    acquire(&bcache.dlock);
+    for (;;)
+    {
+        // Take the named blocks off the queue, wherever they are.
+        m = 0;
+        prev = 0;
+        for (pp = &bcache.dhead; (b = *pp) != 0 && m < NFLUSH;)
+        {
+            for (i = 0; i < n && (b->dev != dev || b->blockno != blocknos[i]); i++)
+                ;
+            if (i == n)
+            {
+                prev = b;
+                pp = &b->dnext;
+                continue;
+            }
+            *pp = b->dnext;
+            if (bcache.dtail == b)
+                bcache.dtail = prev;
+            bcache.nqueued--;
+            bufs[m++] = b;
+        }
+        if (m > 0)
+        {
+            release(&bcache.dlock);
+            bwriteback(bufs, m);
+            acquire(&bcache.dlock);
+            continue;
+        }
+
+        // Any still B_DELWRI are being written by the flusher,
+        // which wakes us when it is done.
+        for (i = 0; i < n && !bdelwri(dev, blocknos[i]); i++)
+            ;
+        if (i == n)
+            break;
+        sleep(&bcache.ndirty, &bcache.dlock);
+    }
+    release(&bcache.dlock);
 }
 
 // Release a locked buffer.
-// Move to the head of the MRU list.
 void brelse(struct buf *b)
 {
+    int front;
+
     if (!holdingsleep(&b->lock))
         panic("brelse");
 
+    if (b->flags & B_RAW)
+    {
+        releasesleep(&b->lock);
+        acquire(&bcache.rawlock);
+        b->next = bcache.rawfree;
+        bcache.rawfree = b;
+        wakeup(&bcache.rawfree);
+        release(&bcache.rawlock);
+        return;
+    }
+    TRACE(TR_ACCESS, b->dev, b->blockno, (b->flags & B_MODIFIED) != 0);
+    b->flags &= ~B_MODIFIED;
+    // Keep clean blocks in the front cache.  Dirty ones are on
+    // their way to the disk and out; pinned ones hit cheaply
+    // anyway, and B_NOREUSE ones are not wanted again.
+    front = (b->flags & (B_VALID | B_DIRTY | B_DELWRI | B_NOREUSE | B_PINNED)) == B_VALID;
     releasesleep(&b->lock);
+    if (front)
+        bstash(b);
+    else
+        bunref(b);
+}
 
-    acquire(&bcache.lock);
-    b->refcnt--;
-    release(&bcache.lock);
+// The disk driver finished an asynchronous request for b,
+// perhaps in an interrupt handler, and holds none of its locks.
+// Pass b to the completion function given to bsubmit().
+void biodone(struct buf *b)
+{
+    void (*done)(struct buf *);
+
+    done = b->iodone;
+    b->iodone = 0;
+    done(b);
+}
+
+// Copy the sum of the per-CPU cache counters to *st;
+// clear them if reset is set.
+void bstat(struct bcstat *st, int reset)
+{
+    uint *sum, *c;
+    int i, j;
+
+    memset(st, 0, sizeof(*st));
+    sum = (uint *)st;
+    for (i = 0; i < NCPU; i++)
+    {
+        c = (uint *)&bcpus[i].st;
+        for (j = 0; j < sizeof(*st) / sizeof(uint); j++)
+            sum[j] += c[j];
+        if (reset)
+            memset(&bcpus[i].st, 0, sizeof(bcpus[i].st));
+    }
+    st->nbuf = bcache.nbuf;
+    st->nmeta = bcache.nclass[BC_META];
+    st->ndata = bcache.nclass[BC_DATA];
+    st->maxdata = bcache.maxclass[BC_DATA];
+    st->nsmall = bcache.policy->ssize();
 }
 // PAGEBREAK!
 //  Blank page.
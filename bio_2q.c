@@ -0,0 +1,161 @@
+// 2Q replacement for the buffer cache (Johnson and Shasha).
+//
+// A block seen for the first time goes on A1in, a FIFO (S)
+// holding about a quarter of the buffers.  Blocks pushed out of
+// A1in are remembered on the ghost queue A1out.  A miss that
+// hits A1out shows real reuse and the block goes on Am, an LRU
+// (M).  Blocks referenced only once never disturb Am.  Blocks
+// read with BH_NOREUSE are not remembered on A1out, and blocks
+// that were hot before the last boot (BH_WARM) go onto Am.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "buf.h"
+#include "bcstat.h"
+#include "bcache.h"
+
+static struct
+{
+    struct spinlock lock;
+    struct buf am;
+    struct buf a1in;
+    struct buf free;
+    int nin; // blocks on A1in
+    int kin; // A1in size to keep
+
+    struct ghostq a1out;
+} q2;
+
+static void
+q2init(struct buf *list, int n, int nsmall, int adapt)
+{
+    struct buf *b;
+
+    initlock(&q2.lock, "bcache.2q");
+    linit(&q2.am);
+    linit(&q2.a1in);
+    linit(&q2.free);
+    while ((b = list->next) != list)
+    {
+        lremove(b);
+        b->buf_type = BQ_FREE;
+        lpush(&q2.free, b);
+    }
+    q2.nin = 0;
+    q2.kin = n / 4 > 0 ? n / 4 : 1;
+    gqinit(&q2.a1out, n / 2 + 1);
+}
+
+static void
+q2hit(struct buf *b)
+{
+    // A hit on A1in is a correlated reference; leave it be.
+    acquire(&q2.lock);
+    if (b->buf_type == BQ_M)
+    {
+        lremove(b);
+        lpush(&q2.am, b);
+    }
+    release(&q2.lock);
+}
+
+// Take b off A1in.
+static struct buf *
+q2fromin(struct buf *b)
+{
+    if (b != 0)
+    {
+        lremove(b);
+        q2.nin--;
+    }
+    return b;
+}
+
+// Find a buffer to reuse: a free one, else the oldest of
+// A1in while it is over its share, else the LRU end of Am.
+static struct buf *
+q2reclaim(void)
+{
+    struct buf *b;
+
+    if (q2.free.next != &q2.free)
+    {
+        b = q2.free.next;
+        bclaim(b); // never fails: a free buffer is unused
+        lremove(b);
+        return b;
+    }
+    if (q2.nin > q2.kin && (b = q2fromin(lclaim(&q2.a1in))) != 0)
+        return b;
+    if ((b = lclaim(&q2.am)) != 0)
+    {
+        lremove(b);
+        return b;
+    }
+    return q2fromin(lclaim(&q2.a1in));
+}
+
+static struct buf *
+q2alloc(uint dev, uint blockno, int hint)
+{
+    struct buf *b;
+    int g, ghit;
+
+    acquire(&q2.lock);
+    // Leave A1out alone until a buffer is claimed, so that an
+    // attempt that finds none keeps the block's entry.
+    g = gqfind(&q2.a1out, dev, blockno);
+    ghit = g >= 0 && (hint & (BH_PREFETCH | BH_NOREUSE)) == 0;
+    if ((b = q2reclaim()) == 0)
+    {
+        release(&q2.lock);
+        return 0;
+    }
+    // Drop the block's entry before the victim's can take its slot.
+    if (g >= 0)
+        gqremove(&q2.a1out, g);
+    if (b->buf_type == BQ_S && (b->flags & B_NOREUSE) == 0)
+        gqadd(&q2.a1out, b->dev, b->blockno);
+    if (ghit || (hint & BH_WARM))
+    {
+        if (ghit)
+        {
+            BCOUNT(ghits);
+            BCOUNT(promotions);
+        }
+        b->buf_type = BQ_M;
+        lpush(&q2.am, b);
+    }
+    else
+    {
+        b->buf_type = BQ_S;
+        lpush(&q2.a1in, b);
+        q2.nin++;
+    }
+    release(&q2.lock);
+    return b;
+}
+
+static void
+q2release(struct buf *b)
+{
+}
+
+static int
+q2ssize(void)
+{
+    return q2.kin;
+}
+
+struct bpolicy twoq_policy = {
+    .name = "2q",
+    .init = q2init,
+    .hit = q2hit,
+    .alloc = q2alloc,
+    .release = q2release,
+    .ssize = q2ssize,
+};
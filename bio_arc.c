@@ -0,0 +1,257 @@
+// ARC replacement for the buffer cache (Megiddo and Modha).
+//
+// T1 (S) holds blocks referenced once recently and T2 (M)
+// blocks referenced at least twice; both are LRU lists.  Their
+// ghost queues B1 and B2 remember blocks evicted from each.
+// A miss that hits B1 means T1 was too small and raises the
+// target size p of T1; a hit in B2 lowers it.  Replacement
+// takes from T1 while it is over p and from T2 otherwise.
+//
+// Buffers that are in use or dirty cannot be evicted, so each
+// step takes the unused buffer nearest the LRU end and falls
+// back to the other list when a list has none.
+//
+// A block read only with BH_NOREUSE stays in T1 even when hit
+// and leaves no entry in B1.  A block that was hot before the
+// last boot (BH_WARM) goes into T2.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "buf.h"
+#include "bcstat.h"
+#include "bcache.h"
+
+static struct
+{
+    struct spinlock lock;
+    struct buf t1;
+    struct buf t2;
+    struct buf free;
+    int nt1;
+    int nt2;
+    int c; // buffers in the cache
+    int p; // target size of T1
+
+    struct ghostq b1;
+    struct ghostq b2;
+} arc;
+
+static void
+arcinit(struct buf *list, int n, int nsmall, int adapt)
+{
+    struct buf *b;
+
+    initlock(&arc.lock, "bcache.arc");
+    linit(&arc.t1);
+    linit(&arc.t2);
+    linit(&arc.free);
+    while ((b = list->next) != list)
+    {
+        lremove(b);
+        b->buf_type = BQ_FREE;
+        lpush(&arc.free, b);
+    }
+    arc.nt1 = 0;
+    arc.nt2 = 0;
+    arc.c = n;
+    arc.p = 0;
+    gqinit(&arc.b1, n);
+    gqinit(&arc.b2, n);
+}
+
+static void
+archit(struct buf *b)
+{
+    if (b->flags & B_NOREUSE)
+        return;
+    acquire(&arc.lock);
+    if (b->buf_type == BQ_S)
+    {
+        arc.nt1--;
+        arc.nt2++;
+        b->buf_type = BQ_M;
+    }
+    lremove(b);
+    lpush(&arc.t2, b);
+    release(&arc.lock);
+}
+
+// Take the LRU unused block off T1.
+static struct buf *
+arcfromt1(void)
+{
+    struct buf *b;
+
+    if ((b = lclaim(&arc.t1)) != 0)
+    {
+        lremove(b);
+        arc.nt1--;
+    }
+    return b;
+}
+
+// Take the LRU unused block off T2.
+static struct buf *
+arcfromt2(void)
+{
+    struct buf *b;
+
+    if ((b = lclaim(&arc.t2)) != 0)
+    {
+        lremove(b);
+        arc.nt2--;
+    }
+    return b;
+}
+
+// ARC's REPLACE with target p for T1: free a buffer for a
+// block that hit B2 if inb2.  The victim still names the block
+// it held; arcalloc() remembers it in B1 or B2.
+static struct buf *
+arcreplace(int inb2, int p)
+{
+    struct buf *b;
+
+    if (arc.free.next != &arc.free)
+    {
+        b = arc.free.next;
+        bclaim(b); // never fails: a free buffer is unused
+        lremove(b);
+        return b;
+    }
+    if (arc.nt1 > 0 && (arc.nt1 > p || (inb2 && arc.nt1 == p)))
+    {
+        if ((b = arcfromt1()) != 0)
+            return b;
+        return arcfromt2();
+    }
+    if ((b = arcfromt2()) != 0)
+        return b;
+    return arcfromt1();
+}
+
+static struct buf *
+arcalloc(uint dev, uint blockno, int hint)
+{
+    struct buf *b;
+    struct ghostq *pop = 0;
+    int i1, i2, n1, n2, d, p, ghit, keep = 1;
+
+    acquire(&arc.lock);
+    // Look the block up in B1 and B2, but change neither, nor
+    // p, until a buffer is claimed: an attempt that finds none,
+    // such as one refused by a class quota, must leave the
+    // block's history to the next.  n1 and n2 are the sizes B1
+    // and B2 will have once the block has left them.
+    i1 = gqfind(&arc.b1, dev, blockno);
+    i2 = gqfind(&arc.b2, dev, blockno);
+    n1 = arc.b1.n - (i1 >= 0);
+    n2 = arc.b2.n - (i2 >= 0);
+    // Without a reference worth keeping, the block's history is
+    // only forgotten, and p stays.
+    ghit = (i1 >= 0 || i2 >= 0) && (hint & (BH_PREFETCH | BH_NOREUSE)) == 0;
+    p = arc.p;
+    if (ghit && i1 >= 0)
+    {
+        d = arc.b2.n > arc.b1.n ? arc.b2.n / arc.b1.n : 1;
+        p = p + d < arc.c ? p + d : arc.c;
+        b = arcreplace(0, p);
+    }
+    else if (ghit)
+    {
+        d = arc.b1.n > arc.b2.n ? arc.b1.n / arc.b2.n : 1;
+        p = p - d > 0 ? p - d : 0;
+        b = arcreplace(1, p);
+    }
+    else if (hint & BH_WARM)
+    {
+        if (arc.nt1 + arc.nt2 + n1 + n2 >= 2 * arc.c)
+            pop = n2 > 0 ? &arc.b2 : &arc.b1;
+        b = arcreplace(0, p);
+    }
+    else if (arc.nt1 + n1 >= arc.c)
+    {
+        // Keep T1+B1 within c.
+        if (arc.nt1 < arc.c)
+        {
+            pop = &arc.b1;
+            b = arcreplace(0, p);
+        }
+        else if ((b = arcfromt1()) != 0)
+            keep = 0; // B1 is empty: drop T1's LRU block outright.
+        else
+            b = arcreplace(0, p);
+    }
+    else
+    {
+        // Keep the whole directory within 2c.
+        if (arc.nt1 + arc.nt2 + n1 + n2 >= 2 * arc.c)
+            pop = &arc.b2;
+        b = arcreplace(0, p);
+    }
+    if (b == 0)
+    {
+        release(&arc.lock);
+        return 0;
+    }
+
+    // The block leaves B1 and B2, and the directory is trimmed,
+    // before the victim's entry can take over a slot.
+    if (i1 >= 0)
+        gqremove(&arc.b1, i1);
+    if (i2 >= 0)
+        gqremove(&arc.b2, i2);
+    if (pop != 0)
+        gqpop(pop);
+    arc.p = p;
+    if (b->buf_type == BQ_S && keep && (b->flags & B_NOREUSE) == 0)
+        gqadd(&arc.b1, b->dev, b->blockno);
+    else if (b->buf_type == BQ_M)
+        gqadd(&arc.b2, b->dev, b->blockno);
+
+    if (ghit || (hint & BH_WARM))
+    {
+        // A ghost hit, or a block hot before the last boot:
+        // straight to T2.
+        if (ghit)
+        {
+            BCOUNT(ghits);
+            BCOUNT(promotions);
+        }
+        b->buf_type = BQ_M;
+        lpush(&arc.t2, b);
+        arc.nt2++;
+    }
+    else
+    {
+        b->buf_type = BQ_S;
+        lpush(&arc.t1, b);
+        arc.nt1++;
+    }
+    release(&arc.lock);
+    return b;
+}
+
+static void
+arcrelease(struct buf *b)
+{
+}
+
+static int
+arcssize(void)
+{
+    return arc.p;
+}
+
+struct bpolicy arc_policy = {
+    .name = "arc",
+    .init = arcinit,
+    .hit = archit,
+    .alloc = arcalloc,
+    .release = arcrelease,
+    .ssize = arcssize,
+};
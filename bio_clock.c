@@ -0,0 +1,106 @@
+// CLOCK replacement for the buffer cache.
+//
+// Buffers form a ring swept by a hand.  A hit sets the buffer's
+// reference bit (b->cnt).  To find a victim the hand clears set
+// bits as it passes and stops at the first unused buffer whose
+// bit is already clear, so a hit costs no list manipulation.
+// Blocks read only with BH_NOREUSE never get the bit.
+//
+// Only alloc moves the hand, and allocs are serialized by
+// bcache.evict, so the ring needs no lock of its own; a hit
+// racing with the sweep at worst loses one reference bit.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "buf.h"
+#include "bcstat.h"
+#include "bcache.h"
+
+static struct
+{
+    struct buf head;
+    struct buf *hand;
+    int n;
+} clk;
+
+// The buffer after b on the ring, skipping the sentinel.
+static struct buf *
+cnext(struct buf *b)
+{
+    b = b->next;
+    if (b == &clk.head)
+        b = b->next;
+    return b;
+}
+
+static void
+clkinit(struct buf *list, int n, int nsmall, int adapt)
+{
+    struct buf *b;
+
+    linit(&clk.head);
+    while ((b = list->next) != list)
+    {
+        lremove(b);
+        b->buf_type = BQ_M;
+        b->cnt = 0;
+        lpush(&clk.head, b);
+    }
+    clk.hand = clk.head.next;
+    clk.n = n;
+}
+
+static void
+clkhit(struct buf *b)
+{
+    if ((b->flags & B_NOREUSE) == 0)
+        b->cnt = 1;
+}
+
+static struct buf *
+clkalloc(uint dev, uint blockno, int hint)
+{
+    struct buf *b;
+    int i;
+
+    // Two sweeps clear every bit, so a third finds nothing new.
+    for (i = 0; i < 2 * clk.n; i++)
+    {
+        b = clk.hand;
+        clk.hand = cnext(b);
+        if (b->cnt)
+        {
+            b->cnt = 0;
+            continue;
+        }
+        if (!bclaim(b))
+            continue;
+        b->cnt = (hint & BH_NOREUSE) == 0;
+        return b;
+    }
+    return 0;
+}
+
+static void
+clkrelease(struct buf *b)
+{
+}
+
+static int
+clkssize(void)
+{
+    return 0;
+}
+
+struct bpolicy clock_policy = {
+    .name = "clock",
+    .init = clkinit,
+    .hit = clkhit,
+    .alloc = clkalloc,
+    .release = clkrelease,
+    .ssize = clkssize,
+};
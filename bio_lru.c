@@ -0,0 +1,81 @@
+// Least-recently-used replacement for the buffer cache,
+// as in upstream xv6.
+//
+// All buffers sit on one list.  brelse() moves a buffer to the
+// front when its last reference goes, and a missing block takes
+// the unused buffer nearest the back.  A block read only with
+// BH_NOREUSE goes to the back instead, to be reused first.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "buf.h"
+#include "bcstat.h"
+#include "bcache.h"
+
+static struct
+{
+    struct spinlock lock;
+    struct buf head;
+} lru;
+
+static void
+lruinit(struct buf *list, int n, int nsmall, int adapt)
+{
+    struct buf *b;
+
+    initlock(&lru.lock, "bcache.lru");
+    linit(&lru.head);
+    while ((b = list->next) != list)
+    {
+        lremove(b);
+        b->buf_type = BQ_M;
+        lpush(&lru.head, b);
+    }
+}
+
+static void
+lruhit(struct buf *b)
+{
+}
+
+static struct buf *
+lrualloc(uint dev, uint blockno, int hint)
+{
+    struct buf *b;
+
+    acquire(&lru.lock);
+    b = lclaim(&lru.head);
+    release(&lru.lock);
+    return b;
+}
+
+static void
+lrurelease(struct buf *b)
+{
+    acquire(&lru.lock);
+    lremove(b);
+    if (b->flags & B_NOREUSE)
+        lpush(lru.head.prev, b); // at the oldest end
+    else
+        lpush(&lru.head, b);
+    release(&lru.lock);
+}
+
+static int
+lrussize(void)
+{
+    return 0;
+}
+
+struct bpolicy lru_policy = {
+    .name = "lru",
+    .init = lruinit,
+    .hit = lruhit,
+    .alloc = lrualloc,
+    .release = lrurelease,
+    .ssize = lrussize,
+};
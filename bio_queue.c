@@ -0,0 +1,167 @@
+// Queues shared by the buffer replacement policies.
+//
+// Buffer lists are doubly linked through prev/next around a
+// sentinel head; head.next is the most recently queued end and
+// head.prev the oldest.
+//
+// Ghost queues remember only which blocks were evicted.  Each is
+// a FIFO ring of (dev, blockno) entries with its own hash chains.
+// New entries go in after the newest and the oldest is dropped
+// when the ring is full.  A ghost hit removes an entry from the
+// middle, leaving a hole that is skipped when the ring wraps.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "buf.h"
+#include "bcstat.h"
+#include "bcache.h"
+
+// Make head an empty list.
+void linit(struct buf *head)
+{
+    head->prev = head;
+    head->next = head;
+}
+
+void lremove(struct buf *b)
+{
+    b->prev->next = b->next;
+    b->next->prev = b->prev;
+}
+
+// Insert b at the most recent end of head.
+void lpush(struct buf *head, struct buf *b)
+{
+    b->next = head->next;
+    b->prev = head;
+    head->next->prev = b;
+    head->next = b;
+}
+
+// Claim the unused buffer nearest the oldest end of head
+// with bclaim(), or return 0.
+struct buf *
+lclaim(struct buf *head)
+{
+    struct buf *b;
+
+    for (b = head->prev; b != head; b = b->prev)
+    {
+        if (bclaim(b))
+            return b;
+    }
+    return 0;
+}
+
+// Entry i of q's ring.
+static struct ghost *
+gent(struct ghostq *q, int i)
+{
+    return &q->dir[i / GPP][i % GPP];
+}
+
+// Make q an empty ghost queue of size entries, taking its
+// pages from bpage().
+void gqinit(struct ghostq *q, int size)
+{
+    int i;
+
+    if ((size + GPP - 1) / GPP > PGSIZE / sizeof(struct ghost *))
+        panic("gqinit: too big");
+    q->size = size;
+    q->head = 0;
+    q->len = 0;
+    q->n = 0;
+    q->nhash = size < PGSIZE / sizeof(int) ? size : PGSIZE / sizeof(int);
+    if (q->nhash == 0)
+        q->nhash = 1;
+    q->hash = bpage();
+    for (i = 0; i < q->nhash; i++)
+        q->hash[i] = -1;
+    q->dir = bpage();
+    for (i = 0; i * GPP < size; i++)
+        q->dir[i] = bpage();
+}
+
+// Return the index of the entry for (dev, blockno), or -1.
+int gqfind(struct ghostq *q, uint dev, uint blockno)
+{
+    int i;
+
+    for (i = q->hash[bhash(dev, blockno) % q->nhash]; i >= 0; i = gent(q, i)->next)
+    {
+        if (gent(q, i)->dev == dev && gent(q, i)->blockno == blockno)
+            return i;
+    }
+    return -1;
+}
+
+// Forget entry i; a no-op if it is a hole.
+void gqremove(struct ghostq *q, int i)
+{
+    struct ghost *g = gent(q, i);
+    int *pp;
+
+    if (!g->used)
+        return;
+    for (pp = &q->hash[bhash(g->dev, g->blockno) % q->nhash]; *pp >= 0; pp = &gent(q, *pp)->next)
+    {
+        if (*pp == i)
+        {
+            *pp = g->next;
+            break;
+        }
+    }
+    g->used = 0;
+    q->n--;
+}
+
+// Forget the oldest entry, if any.
+void gqpop(struct ghostq *q)
+{
+    int i;
+
+    while (q->len > 0)
+    {
+        i = q->head;
+        q->head = (q->head + 1) % q->size;
+        q->len--;
+        if (gent(q, i)->used)
+        {
+            gqremove(q, i);
+            return;
+        }
+    }
+}
+
+// Remember (dev, blockno) as the newest entry,
+// dropping the oldest slot if the ring is full.
+void gqadd(struct ghostq *q, uint dev, uint blockno)
+{
+    struct ghost *g;
+    int i, h;
+
+    if (q->size == 0)
+        return;
+    if (q->len == q->size)
+    {
+        gqremove(q, q->head);
+        q->head = (q->head + 1) % q->size;
+        q->len--;
+    }
+    i = (q->head + q->len) % q->size;
+    q->len++;
+    g = gent(q, i);
+    h = bhash(dev, blockno) % q->nhash;
+    g->dev = dev;
+    g->blockno = blockno;
+    g->used = 1;
+    g->next = q->hash[h];
+    q->hash[h] = i;
+    q->n++;
+}
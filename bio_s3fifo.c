@@ -0,0 +1,263 @@
+// S3-FIFO replacement for the buffer cache (Yang et al.).
+//
+// Resident blocks sit on two FIFO queues: a small probationary
+// queue S, meant to hold nsmall buffers (BCSMALL percent), and
+// a main queue M.  A hit only bumps the block's frequency
+// b->cnt, a counter saturating at S3MAXCNT.  A new block goes
+// into S.  When S is over its share, its oldest block is
+// evicted into the ghost queue G if it was never hit there,
+// and otherwise moves to M: most blocks are used once and leave
+// through S without ever disturbing M.  M is swept like CLOCK:
+// an old block with a nonzero count goes back to the head with
+// the count decremented, and one with a zero count is evicted.
+// A miss on a block still in G shows reuse soon after eviction,
+// and the block goes straight into M, as do blocks that were
+// hot before the last boot (BH_WARM).  Read-ahead blocks always
+// go into S, and blocks read with BH_NOREUSE (B_NOREUSE) never
+// leave it: their hits are not counted and they are evicted
+// without a trace in G.
+//
+// With adapt set, S's share moves at run time, in the style
+// of ARC.  A second ghost queue GM remembers blocks evicted from
+// M.  A miss found in G was evicted from S too soon, so S grows;
+// one found in GM was evicted from M too soon, so S shrinks
+// and M grows.  Each step is the larger ghost queue's length
+// over the smaller's, and at least one buffer.  A block found in
+// GM goes back into M.
+//
+// Only alloc moves blocks between queues, and allocs are
+// serialized by bcache.evict, so the queues need no lock of
+// their own; a hit racing with a sweep at worst loses a count.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "buf.h"
+#include "bcstat.h"
+#include "bcache.h"
+
+#define S3MAXCNT 3 // b->cnt is a 2-bit counter
+
+static struct
+{
+    struct buf mhead;
+    struct buf shead;
+    struct buf free;
+    int nm;
+    int ns;
+    int ksmall; // S size to keep
+    int n;      // buffers in the cache
+    int adapt;  // move ksmall with G and GM hits
+
+    struct ghostq g;
+    struct ghostq gm; // evicted from M, if adapt
+} s3;
+
+static void
+s3init(struct buf *list, int n, int nsmall, int adapt)
+{
+    struct buf *b;
+
+    linit(&s3.mhead);
+    linit(&s3.shead);
+    linit(&s3.free);
+    while ((b = list->next) != list)
+    {
+        lremove(b);
+        b->buf_type = BQ_FREE;
+        lpush(&s3.free, b);
+    }
+    s3.nm = 0;
+    s3.ns = 0;
+    s3.ksmall = nsmall > 0 ? nsmall : 1;
+    s3.n = n;
+    s3.adapt = adapt && n > 1;
+    // G remembers as many blocks as M holds; when S's share
+    // moves, G and GM each remember as many as the cache holds.
+    if (s3.adapt)
+    {
+        gqinit(&s3.g, n);
+        gqinit(&s3.gm, n);
+    }
+    else
+        gqinit(&s3.g, n - nsmall > 0 ? n - nsmall : 1);
+}
+
+static void
+s3hit(struct buf *b)
+{
+    if (b->cnt < S3MAXCNT && (b->flags & B_NOREUSE) == 0)
+        b->cnt++;
+}
+
+// Evict the oldest block of S that was not hit, moving the ones
+// that were to M.  Blocks that cannot be claimed (in use, dirty,
+// or refused by a class quota) are passed over where they lie,
+// so S keeps its FIFO order for the next attempt.
+static struct buf *
+s3evicts(void)
+{
+    struct buf *b, *prev;
+
+    for (b = s3.shead.prev; b != &s3.shead; b = prev)
+    {
+        prev = b->prev;
+        if (b->cnt > 0)
+        {
+            BCOUNT(promotions);
+            lremove(b);
+            b->cnt = 0;
+            b->buf_type = BQ_M;
+            lpush(&s3.mhead, b);
+            s3.ns--;
+            s3.nm++;
+            continue;
+        }
+        if (bclaim(b))
+        {
+            lremove(b);
+            s3.ns--;
+            return b;
+        }
+    }
+    return 0;
+}
+
+// Evict the oldest block of M whose count has run out,
+// reinserting the others with one count less.  The counts stop
+// at S3MAXCNT, so S3MAXCNT+1 sweeps find an unused block if
+// there is one.
+static struct buf *
+s3evictm(void)
+{
+    struct buf *b;
+    int i;
+
+    for (i = (S3MAXCNT + 1) * s3.nm; i > 0; i--)
+    {
+        b = s3.mhead.prev;
+        lremove(b);
+        if (b->cnt > 0)
+            b->cnt--;
+        else if (bclaim(b))
+        {
+            s3.nm--;
+            return b;
+        }
+        lpush(&s3.mhead, b);
+    }
+    return 0;
+}
+
+// Remember b, just evicted, in the ghost queue of the queue it
+// left.
+static void
+s3ghost(struct buf *b)
+{
+    if ((b->flags & (B_VALID | B_NOREUSE)) != B_VALID)
+        return;
+    if (b->buf_type == BQ_S)
+        gqadd(&s3.g, b->dev, b->blockno);
+    else if (b->buf_type == BQ_M && s3.adapt)
+        gqadd(&s3.gm, b->dev, b->blockno);
+}
+
+static struct buf *
+s3alloc(uint dev, uint blockno, int hint)
+{
+    struct buf *b;
+    int g, gm, ng, ngm, d, ksmall, ghit;
+
+    // Look the block up in G and GM, but change neither, nor
+    // ksmall, until a buffer is claimed: an attempt that finds
+    // none, such as one refused by a class quota, must leave the
+    // block's history to the next.  ng and ngm are the sizes G
+    // and GM will have once the block has left them.
+    g = gqfind(&s3.g, dev, blockno);
+    gm = s3.adapt ? gqfind(&s3.gm, dev, blockno) : -1;
+    ng = s3.g.n - (g >= 0);
+    ngm = s3.gm.n - (gm >= 0);
+    ghit = (hint & (BH_PREFETCH | BH_NOREUSE)) == 0 && (g >= 0 || gm >= 0);
+    ksmall = s3.ksmall;
+    if (ghit && g >= 0)
+    {
+        if (s3.adapt)
+        {
+            d = ngm > ng && ng > 0 ? ngm / ng : 1;
+            ksmall = ksmall + d < s3.n ? ksmall + d : s3.n - 1;
+        }
+    }
+    else if (ghit)
+    {
+        d = ng > ngm && ngm > 0 ? ng / ngm : 1;
+        ksmall = ksmall - d > 1 ? ksmall - d : 1;
+    }
+
+    if (s3.free.next != &s3.free)
+    {
+        b = s3.free.next;
+        bclaim(b); // never fails: a free buffer is unused
+        lremove(b);
+    }
+    else if (s3.ns >= ksmall || s3.nm == 0)
+    {
+        if ((b = s3evicts()) == 0)
+            b = s3evictm();
+    }
+    else if ((b = s3evictm()) == 0)
+        b = s3evicts();
+    if (b == 0)
+        return 0;
+
+    // The block is about to become resident, so it leaves G and
+    // GM, before the victim's entry can take over a slot.
+    if (g >= 0)
+        gqremove(&s3.g, g);
+    if (gm >= 0)
+        gqremove(&s3.gm, gm);
+    s3.ksmall = ksmall;
+    s3ghost(b);
+
+    b->cnt = 0;
+    if (ghit || (hint & BH_WARM))
+    {
+        if (ghit)
+        {
+            BCOUNT(ghits);
+            BCOUNT(promotions);
+        }
+        b->buf_type = BQ_M;
+        lpush(&s3.mhead, b);
+        s3.nm++;
+    }
+    else
+    {
+        b->buf_type = BQ_S;
+        lpush(&s3.shead, b);
+        s3.ns++;
+    }
+    return b;
+}
+
+static void
+s3release(struct buf *b)
+{
+}
+
+static int
+s3ssize(void)
+{
+    return s3.ksmall;
+}
+
+struct bpolicy s3fifo_policy = {
+    .name = "s3fifo",
+    .init = s3init,
+    .hit = s3hit,
+    .alloc = s3alloc,
+    .release = s3release,
+    .ssize = s3ssize,
+};
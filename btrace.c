@@ -0,0 +1,60 @@
+// Drain and print the kernel's tracepoint records.
+// The kernel must be built with "make BTRACE=1".
+//
+// btrace -a prints only the block accesses, one per line as
+// "dev blockno r" or "dev blockno w": the trace format that
+// the host-side simulator bcsim replays.  Records are kept per
+// CPU, so run with CPUS=1 for the exact order of accesses.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "trace.h"
+
+#define NREC 64
+
+struct trace rec[NREC];
+
+char *evname[] = {
+[TR_READ]   "read",
+[TR_WRITE]  "write",
+[TR_HIT]    "hit",
+[TR_MISS]   "miss",
+[TR_EVICT]  "evict",
+[TR_PREFETCH] "prefetch",
+[TR_ACCESS] "access",
+};
+
+int
+main(int argc, char *argv[])
+{
+  int i, n, aflag;
+  char *name;
+
+  aflag = 0;
+  if(argc == 2 && strcmp(argv[1], "-a") == 0)
+    aflag = 1;
+  else if(argc != 1){
+    printf(2, "usage: btrace [-a]\n");
+    exit();
+  }
+
+  while((n = btrace(rec, NREC)) > 0){
+    for(i = 0; i < n; i++){
+      if(aflag){
+        if(rec[i].ev == TR_ACCESS)
+          printf(1, "%d %d %c\n", rec[i].dev, rec[i].blockno,
+                 rec[i].arg ? 'w' : 'r');
+        continue;
+      }
+      name = "?";
+      if(rec[i].ev < sizeof(evname)/sizeof(evname[0]) && evname[rec[i].ev])
+        name = evname[rec[i].ev];
+      printf(1, "%d cpu%d %s %d %d %d\n", rec[i].tick, rec[i].cpu,
+             name, rec[i].dev, rec[i].blockno, rec[i].arg);
+    }
+  }
+  if(n < 0)
+    printf(2, "btrace: kernel built without BTRACE=1\n");
+  exit();
+}
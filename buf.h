@@ -8,9 +8,40 @@ struct buf {
   uint cnt;
   struct buf *prev; // LRU cache list
   struct buf *next;
+  struct buf *hnext; // buffer cache hash chain
   struct buf *qnext; // disk queue
+  struct buf *cnext; // next block of a multi-block request
+  struct buf *dnext; // delayed-write queue
+  uint dtick;        // ticks when it joined the delayed-write queue
+  uint qtick;        // ticks when it joined the disk queue
+  uint bclass;       // BC_*: class of the block it holds
+  uint fhit;         // hit in a front cache; policy not yet told
+  void (*iodone)(struct buf*); // B_ASYNC: called through biodone()
   uchar data[BSIZE];
 };
 #define B_VALID 0x2  // buffer has been read from disk
 #define B_DIRTY 0x4  // buffer needs to be written to disk
+#define B_ASYNC 0x8  // nobody waits for the request; the driver calls biodone()
+#define B_DELWRI 0x10  // delayed write, queued for the flusher
+#define B_MODIFIED 0x20  // written by its current holder (for tracing)
+#define B_NOREUSE 0x40  // only read with BH_NOREUSE so far
+#define B_RAW 0x80  // log buffer outside the cache (bgetraw)
+#define B_PINNED 0x100  // cached for good, outside the policy (bpin)
+
+// Hints to bread(), breadn() and bprefetch() about the blocks.
+// Every caller names the class of the block: BH_DATA, BH_META
+// or BH_LOG.
+#define BH_PREFETCH 0x1  // read ahead, not yet referenced: keep it out of M
+#define BH_NOREUSE  0x2  // read once and not again soon
+#define BH_DATA     0x0  // file contents
+#define BH_META     0x4  // superblock, inodes, bitmap, directories, indirect blocks
+#define BH_LOG      0x8  // the log: read around the cache
+#define BH_WARM     0x10 // was hot before the last boot: straight to M
+#define BH_NOWAIT   0x20 // a miss gives up rather than wait for a buffer (breadn)
+
+// Classes of cached blocks, in b->bclass.
+#define BC_NONE 0  // holds no block
+#define BC_DATA 1
+#define BC_META 2
+#define NBCLASS 3
 
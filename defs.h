@@ -1,7 +1,9 @@
+struct bcstat;
 struct buf;
 struct context;
 struct file;
 struct inode;
+struct iostat;
 struct pipe;
 struct proc;
 struct rtcdate;
@@ -9,12 +11,28 @@ struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct trace;
 
 // bio.c
 void            binit(void);
-struct buf*     bread(uint, uint);
+struct buf*     bread(uint, uint, int);
+struct buf*     bgetraw(uint, uint);
+int             breadn(uint, uint, int, struct buf**, int);
 void            brelse(struct buf*);
 void            bwrite(struct buf*);
+void            bwritev(struct buf**, int);
+void            bdwrite(struct buf*);
+void            bflush(void);
+void            bflushn(uint, int*, int);
+void            bflushinit(void);
+void            bstat(struct bcstat*, int);
+void            bprefetch(uint, uint, int, int);
+void            bsubmit(struct buf*, void (*)(struct buf*));
+void            bwait(struct buf**, int);
+void            biodone(struct buf*);
+int             bpin(uint, uint);
+void            bhotsave(uint, uint);
+void            bprewarm(uint, uint, uint);
 
 // console.c
 void            consoleinit(void);
@@ -41,6 +59,8 @@ struct inode*   dirlookup(struct inode*, char*, uint*);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
 void            iinit(int dev);
+void            fssync(int);
+void            fsprewarm(int);
 void            ilock(struct inode*);
 void            iput(struct inode*);
 void            iunlock(struct inode*);
@@ -49,14 +69,21 @@ void            iupdate(struct inode*);
 int             namecmp(const char*, const char*);
 struct inode*   namei(char*);
 struct inode*   nameiparent(char*, char*);
-int             readi(struct inode*, char*, uint, uint);
+int             readi(struct inode*, char*, uint, uint, int);
+int             iadvise(struct inode*, uint, uint, int);
 void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, char*, uint, uint);
 
+// fwcfg.c
+int             bootparam(char*, char*, int);
+int             bootparamint(char*, int);
+
 // ide.c
 void            ideinit(void);
 void            ideintr(void);
-void            iderw(struct buf*);
+void            idesubmit(struct buf*);
+void            ideiowait(struct buf*);
+void            idestat(struct iostat*, int);
 
 // ioapic.c
 void            ioapicenable(int irq, int cpu);
@@ -66,6 +93,7 @@ void            ioapicinit(void);
 // kalloc.c
 char*           kalloc(void);
 void            kfree(char*);
+int             kfreepages(void);
 void            kinit1(void*, void*);
 void            kinit2(void*, void*);
 
@@ -91,6 +119,12 @@ void            end_op();
 extern int      ismp;
 void            mpinit(void);
 
+// pci.c
+uint            pciread(int, int);
+void            pciwrite(int, int, uint);
+int             pcifind(uint, uint);
+int             pcifindclass(uint, uint);
+
 // picirq.c
 void            picenable(int);
 void            picinit(void);
@@ -117,6 +151,7 @@ void            sched(void);
 void            setproc(struct proc*);
 void            sleep(void*, struct spinlock*);
 void            userinit(void);
+void            kthread(char*, void(*)(void));
 int             wait(void);
 void            wakeup(void*);
 void            yield(void);
@@ -136,6 +171,7 @@ void            popcli(void);
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
 void            releasesleep(struct sleeplock*);
+int             tryacquiresleep(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
 
@@ -162,9 +198,20 @@ void            timerinit(void);
 // trap.c
 void            idtinit(void);
 extern uint     ticks;
+extern int      diskirq;
 void            tvinit(void);
 extern struct spinlock tickslock;
 
+// trace.c
+void            traceinit(void);
+int             tracedrain(struct trace*, int);
+void            trace(int, uint, uint, uint);
+#ifdef BTRACE
+#define TRACE(ev, dev, blockno, arg) trace(ev, dev, blockno, arg)
+#else
+#define TRACE(ev, dev, blockno, arg) do { if(0) trace(ev, dev, blockno, arg); } while(0)
+#endif
+
 // uart.c
 void            uartinit(void);
 void            uartintr(void);
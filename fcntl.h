@@ -2,3 +2,9 @@
 #define O_WRONLY  0x001
 #define O_RDWR    0x002
 #define O_CREATE  0x200
+
+// fadvise() advice
+#define FADV_NORMAL     0  // no advice
+#define FADV_SEQUENTIAL 1  // will be read in order: read ahead far
+#define FADV_NOREUSE    2  // will be read once: do not keep it cached
+#define FADV_WILLNEED   3  // will be read soon: start reading it now
@@ -6,6 +6,7 @@ struct file {
   struct pipe *pipe;
   struct inode *ip;
   uint off;
+  int advice; // fadvise() advice, FADV_*
 };
 
 
@@ -23,6 +24,10 @@ struct inode {
   short nlink;
   uint size;
   uint addrs[NDIRECT+1];
+
+  uint ranext;        // read-ahead: block after the last one read
+  uint rawin;         // read-ahead window, in blocks
+  uint raend;         // first block not yet read ahead
 };
 
 // table mapping major device number to
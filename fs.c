@@ -20,6 +20,7 @@
 #include "fs.h"
 #include "buf.h"
 #include "file.h"
+#include "fcntl.h"
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 static void itrunc(struct inode*);
@@ -33,18 +34,18 @@ readsb(int dev, struct superblock *sb)
 {
   struct buf *bp;
 
-  bp = bread(dev, 1);
+  bp = bread(dev, 1, BH_META);
   memmove(sb, bp->data, sizeof(*sb));
   brelse(bp);
 }
 
-// Zero a block.
+// Zero a block of class hint (BH_DATA or BH_META).
 static void
-bzero(int dev, int bno)
+bzero(int dev, int bno, int hint)
 {
   struct buf *bp;
 
-  bp = bread(dev, bno);
+  bp = bread(dev, bno, hint);
   memset(bp->data, 0, BSIZE);
   log_write(bp);
   brelse(bp);
@@ -52,23 +53,23 @@ bzero(int dev, int bno)
 
 // Blocks.
 
-// Allocate a zeroed disk block.
+// Allocate a zeroed disk block, to hold a block of class hint.
 static uint
-balloc(uint dev)
+balloc(uint dev, int hint)
 {
   int b, bi, m;
   struct buf *bp;
 
   bp = 0;
   for(b = 0; b < sb.size; b += BPB){
-    bp = bread(dev, BBLOCK(b, sb));
+    bp = bread(dev, BBLOCK(b, sb), BH_META);
     for(bi = 0; bi < BPB && b + bi < sb.size; bi++){
       m = 1 << (bi % 8);
       if((bp->data[bi/8] & m) == 0){  // Is block free?
         bp->data[bi/8] |= m;  // Mark block in use.
         log_write(bp);
         brelse(bp);
-        bzero(dev, b + bi);
+        bzero(dev, b + bi, hint);
         return b + bi;
       }
     }
@@ -84,7 +85,7 @@ bfree(int dev, uint b)
   struct buf *bp;
   int bi, m;
 
-  bp = bread(dev, BBLOCK(b, sb));
+  bp = bread(dev, BBLOCK(b, sb), BH_META);
   bi = b % BPB;
   m = 1 << (bi % 8);
   if((bp->data[bi/8] & m) == 0)
@@ -168,6 +169,30 @@ struct {
   struct inode inode[NINODE];
 } icache;
 
+// Pin the blocks every file operation needs into the buffer
+// cache: the bitmap, the root inode's block and the root
+// directory's direct blocks.  The log has not been recovered
+// yet, so the root's block list may be stale; that only wastes
+// a pin, since all reads of a block go through its one buffer.
+static void
+ipin(int dev)
+{
+  struct buf *bp;
+  struct dinode *dip;
+  uint b;
+  int i;
+
+  for(b = 0; b < sb.size; b += BPB)
+    bpin(dev, BBLOCK(b, sb));
+  bpin(dev, IBLOCK(ROOTINO, sb));
+  bp = bread(dev, IBLOCK(ROOTINO, sb), BH_META);
+  dip = (struct dinode*)bp->data + ROOTINO%IPB;
+  for(i = 0; i < NDIRECT; i++)
+    if(dip->addrs[i])
+      bpin(dev, dip->addrs[i]);
+  brelse(bp);
+}
+
 void
 iinit(int dev)
 {
@@ -178,11 +203,31 @@ iinit(int dev)
     initsleeplock(&icache.inode[i].lock, "inode");
   }
 
+  bpin(dev, 1);
   readsb(dev, &sb);
   cprintf("sb: size %d nblocks %d ninodes %d nlog %d logstart %d\
  inodestart %d bmap start %d\n", sb.size, sb.nblocks,
           sb.ninodes, sb.nlog, sb.logstart, sb.inodestart,
           sb.bmapstart);
+  ipin(dev);
+}
+
+// Start reading back the hot set the last fssync() recorded.
+// Call it once initlog() has recovered the log: until then the
+// home copies of logged blocks may be stale.
+void
+fsprewarm(int dev)
+{
+  bprewarm(dev, sb.hotstart, sb.size);
+}
+
+// Write dev's delayed writes to disk and record the buffer
+// cache's hot set for the next boot to read back.
+void
+fssync(int dev)
+{
+  bflush();
+  bhotsave(dev, sb.hotstart);
 }
 
 static struct inode* iget(uint dev, uint inum);
@@ -199,7 +244,7 @@ ialloc(uint dev, short type)
   struct dinode *dip;
 
   for(inum = 1; inum < sb.ninodes; inum++){
-    bp = bread(dev, IBLOCK(inum, sb));
+    bp = bread(dev, IBLOCK(inum, sb), BH_META);
     dip = (struct dinode*)bp->data + inum%IPB;
     if(dip->type == 0){  // a free inode
       memset(dip, 0, sizeof(*dip));
@@ -223,7 +268,7 @@ iupdate(struct inode *ip)
   struct buf *bp;
   struct dinode *dip;
 
-  bp = bread(ip->dev, IBLOCK(ip->inum, sb));
+  bp = bread(ip->dev, IBLOCK(ip->inum, sb), BH_META);
   dip = (struct dinode*)bp->data + ip->inum%IPB;
   dip->type = ip->type;
   dip->major = ip->major;
@@ -296,7 +341,7 @@ ilock(struct inode *ip)
   acquiresleep(&ip->lock);
 
   if(ip->valid == 0){
-    bp = bread(ip->dev, IBLOCK(ip->inum, sb));
+    bp = bread(ip->dev, IBLOCK(ip->inum, sb), BH_META);
     dip = (struct dinode*)bp->data + ip->inum%IPB;
     ip->type = dip->type;
     ip->major = dip->major;
@@ -305,6 +350,9 @@ ilock(struct inode *ip)
     ip->size = dip->size;
     memmove(ip->addrs, dip->addrs, sizeof(ip->addrs));
     brelse(bp);
+    ip->ranext = 0;
+    ip->rawin = 0;
+    ip->raend = 0;
     ip->valid = 1;
     if(ip->type == 0)
       panic("ilock: no type");
@@ -367,6 +415,14 @@ iunlockput(struct inode *ip)
 // are listed in ip->addrs[].  The next NINDIRECT blocks are
 // listed in block ip->addrs[NDIRECT].
 
+// The buffer cache class of ip's contents: a directory's
+// blocks are metadata.
+static int
+iclass(struct inode *ip)
+{
+  return ip->type == T_DIR ? BH_META : BH_DATA;
+}
+
 // Return the disk block address of the nth block in inode ip.
 // If there is no such block, bmap allocates one.
 static uint
@@ -377,7 +433,7 @@ bmap(struct inode *ip, uint bn)
 
   if(bn < NDIRECT){
     if((addr = ip->addrs[bn]) == 0)
-      ip->addrs[bn] = addr = balloc(ip->dev);
+      ip->addrs[bn] = addr = balloc(ip->dev, iclass(ip));
     return addr;
   }
   bn -= NDIRECT;
@@ -385,11 +441,11 @@ bmap(struct inode *ip, uint bn)
   if(bn < NINDIRECT){
     // Load indirect block, allocating if necessary.
     if((addr = ip->addrs[NDIRECT]) == 0)
-      ip->addrs[NDIRECT] = addr = balloc(ip->dev);
-    bp = bread(ip->dev, addr);
+      ip->addrs[NDIRECT] = addr = balloc(ip->dev, BH_META);
+    bp = bread(ip->dev, addr, BH_META);
     a = (uint*)bp->data;
     if((addr = a[bn]) == 0){
-      a[bn] = addr = balloc(ip->dev);
+      a[bn] = addr = balloc(ip->dev, iclass(ip));
       log_write(bp);
     }
     brelse(bp);
@@ -419,7 +475,7 @@ itrunc(struct inode *ip)
   }
 
   if(ip->addrs[NDIRECT]){
-    bp = bread(ip->dev, ip->addrs[NDIRECT]);
+    bp = bread(ip->dev, ip->addrs[NDIRECT], BH_META);
     a = (uint*)bp->data;
     for(j = 0; j < NINDIRECT; j++){
       if(a[j])
@@ -447,13 +503,107 @@ stati(struct inode *ip, struct stat *st)
 }
 
 //PAGEBREAK!
-// Read data from inode.
+// Start reading blocks from up to end of ip, which must lie
+// inside the file so that bmap() will not allocate them, a run
+// of adjacent disk blocks at a time, for a reader with the given
+// fadvise() advice.  Nothing waits for them.
+static void
+prefetch(struct inode *ip, uint from, uint end, int advice)
+{
+  uint addr, n;
+  int hint;
+
+  hint = iclass(ip);
+  if(advice == FADV_NOREUSE)
+    hint |= BH_NOREUSE;
+  for(; from < end; from += n){
+    addr = bmap(ip, from);
+    for(n = 1; n < MAXRUN && from + n < end; n++)
+      if(bmap(ip, from + n) != addr + n)
+        break;
+    bprefetch(ip->dev, addr, n, hint);
+  }
+}
+
+// Sequential read-ahead.
+// readi() has just read block bn of ip.  Reading the block
+// after the previous one continues a streak, and each step of
+// a streak doubles the window, up to RAMAX blocks, that is
+// kept read ahead of the reader.  Any other block ends the
+// streak.  When the reader's advice is FADV_SEQUENTIAL every
+// read is taken to be part of a streak and the window is always
+// RAMAX blocks.
+// The blocks land in the cache while the reader works on what
+// it has.
+// Caller must hold ip->lock, and no buffer: bmap() may have to
+// wait for an indirect block.
+static void
+readahead(struct inode *ip, uint bn, int advice)
+{
+  uint end, last;
+
+  if(bn + 1 == ip->ranext)  // same block again
+    return;
+  if(bn != ip->ranext){
+    ip->ranext = bn + 1;
+    ip->rawin = 0;
+    ip->raend = bn + 1;
+    if(advice != FADV_SEQUENTIAL)
+      return;
+  }
+  ip->ranext = bn + 1;
+  if(advice == FADV_SEQUENTIAL)
+    ip->rawin = RAMAX;
+  else
+    ip->rawin = ip->rawin == 0 ? 2 : min(2*ip->rawin, RAMAX);
+
+  last = (ip->size + BSIZE - 1) / BSIZE;
+  end = min(bn + 1 + ip->rawin, last);
+  if(ip->raend < bn + 1)
+    ip->raend = bn + 1;
+  if(ip->raend < end){
+    prefetch(ip, ip->raend, end, advice);
+    ip->raend = end;
+  }
+}
+
+// Check fadvise() advice for ip.  FADV_WILLNEED starts reading
+// the n bytes at off, or the rest of the file if n is 0; the
+// others say how one open file will be read from now on, and
+// the caller keeps them with it for readi().
 // Caller must hold ip->lock.
 int
-readi(struct inode *ip, char *dst, uint off, uint n)
+iadvise(struct inode *ip, uint off, uint n, int advice)
 {
-  uint tot, m;
-  struct buf *bp;
+  uint end;
+
+  if(ip->type == T_DEV)
+    return -1;
+  switch(advice){
+  case FADV_NORMAL:
+  case FADV_SEQUENTIAL:
+  case FADV_NOREUSE:
+    return 0;
+  case FADV_WILLNEED:
+    if(off >= ip->size)
+      return 0;
+    end = ip->size;
+    if(n > 0 && n < ip->size - off)
+      end = off + n;
+    prefetch(ip, off/BSIZE, (end + BSIZE - 1)/BSIZE, FADV_NORMAL);
+    return 0;
+  }
+  return -1;
+}
+
+// Read data from inode, for a reader with the given fadvise()
+// advice (FADV_NORMAL if it has none).
+// Caller must hold ip->lock.
+int
+readi(struct inode *ip, char *dst, uint off, uint n, int advice)
+{
+  uint tot, m, bn, addr, nb, i;
+  struct buf *bufs[MAXRUN];
 
   if(ip->type == T_DEV){
     if(ip->major < 0 || ip->major >= NDEV || !devsw[ip->major].read)
@@ -466,11 +616,23 @@ readi(struct inode *ip, char *dst, uint off, uint n)
   if(off + n > ip->size)
     n = ip->size - off;
 
-  for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
-    bp = bread(ip->dev, bmap(ip, off/BSIZE));
-    m = min(n - tot, BSIZE - off%BSIZE);
-    memmove(dst, bp->data + off%BSIZE, m);
-    brelse(bp);
+  // Read the blocks that lie next to each other on disk,
+  // up to MAXRUN of them, at once.
+  for(tot=0; tot<n; ){
+    bn = off/BSIZE;
+    addr = bmap(ip, bn);
+    for(nb = 1; nb < MAXRUN && (bn+nb)*BSIZE < off+n-tot; nb++)
+      if(bmap(ip, bn+nb) != addr+nb)
+        break;
+    nb = breadn(ip->dev, addr, nb, bufs,
+                iclass(ip) | (advice == FADV_NOREUSE ? BH_NOREUSE : 0));
+    for(i = 0; i < nb; i++, tot+=m, off+=m, dst+=m){
+      m = min(n - tot, BSIZE - off%BSIZE);
+      memmove(dst, bufs[i]->data + off%BSIZE, m);
+      brelse(bufs[i]);
+    }
+    for(i = 0; i < nb; i++)
+      readahead(ip, bn+i, advice);
   }
   return n;
 }
@@ -496,7 +658,7 @@ writei(struct inode *ip, char *src, uint off, uint n)
     return -1;
 
   for(tot=0; tot<n; tot+=m, off+=m, src+=m){
-    bp = bread(ip->dev, bmap(ip, off/BSIZE));
+    bp = bread(ip->dev, bmap(ip, off/BSIZE), iclass(ip));
     m = min(n - tot, BSIZE - off%BSIZE);
     memmove(bp->data + off%BSIZE, src, m);
     log_write(bp);
@@ -531,7 +693,7 @@ dirlookup(struct inode *dp, char *name, uint *poff)
     panic("dirlookup not DIR");
 
   for(off = 0; off < dp->size; off += sizeof(de)){
-    if(readi(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
+    if(readi(dp, (char*)&de, off, sizeof(de), FADV_NORMAL) != sizeof(de))
       panic("dirlookup read");
     if(de.inum == 0)
       continue;
@@ -563,7 +725,7 @@ dirlink(struct inode *dp, char *name, uint inum)
 
   // Look for an empty dirent.
   for(off = 0; off < dp->size; off += sizeof(de)){
-    if(readi(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
+    if(readi(dp, (char*)&de, off, sizeof(de), FADV_NORMAL) != sizeof(de))
       panic("dirlink read");
     if(de.inum == 0)
       break;
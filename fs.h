@@ -19,6 +19,19 @@ struct superblock {
   uint logstart;     // Block number of first log block
   uint inodestart;   // Block number of first inode block
   uint bmapstart;    // Block number of first free map block
+  uint hotstart;     // Block number of the hot set record
+};
+
+// The hot set record: blocks in the buffer cache's main queue
+// at the last sync(), read back at boot to warm the cache.
+#define HOTMAGIC 0x21746f68  // "hot!"
+#define HOTMETA  0x80000000  // in blockno[]: a metadata block
+#define NHOT ((BSIZE - 2*sizeof(uint)) / sizeof(uint))
+
+struct hotset {
+  uint magic;
+  uint n;
+  uint blockno[NHOT];
 };
 
 #define NDIRECT 12
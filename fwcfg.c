@@ -0,0 +1,97 @@
+// Boot parameters from QEMU's firmware configuration device.
+//
+// QEMU hands named strings to the guest through two I/O ports,
+// for example
+//   qemu ... -fw_cfg name=opt/xv6/bcpolicy,string=arc
+// and the kernel reads them as boot parameters.  On machines
+// without the device the signature check fails and every
+// lookup reports the parameter as absent.
+
+#include "types.h"
+#include "defs.h"
+#include "x86.h"
+
+#define FW_CFG_CTL       0x510  // selector (16 bits)
+#define FW_CFG_DATA      0x511  // data, a byte at a time
+
+#define FW_CFG_SIGNATURE 0x00
+#define FW_CFG_FILE_DIR  0x19
+
+// A file directory entry; numbers are big-endian.
+struct fwcfgfile {
+  uchar size[4];
+  uchar select[2];
+  uchar reserved[2];
+  char name[56];
+};
+
+static void
+fwcfgread(void *dst, int n)
+{
+  uchar *p;
+
+  for(p = dst; n > 0; n--)
+    *p++ = inb(FW_CFG_DATA);
+}
+
+static uint
+be32(uchar *p)
+{
+  return (p[0]<<24) | (p[1]<<16) | (p[2]<<8) | p[3];
+}
+
+// Copy the value of boot parameter name into buf, which holds n
+// bytes, NUL-terminated and without a trailing newline.
+// Returns the length copied, or -1 if name was not given.
+int
+bootparam(char *name, char *buf, int n)
+{
+  struct fwcfgfile f;
+  uchar sig[4];
+  uint i, count, size;
+
+  if(n <= 0)
+    return -1;
+  outw(FW_CFG_CTL, FW_CFG_SIGNATURE);
+  fwcfgread(sig, sizeof(sig));
+  if(memcmp(sig, "QEMU", sizeof(sig)) != 0)
+    return -1;
+
+  outw(FW_CFG_CTL, FW_CFG_FILE_DIR);
+  fwcfgread(sig, sizeof(sig));
+  count = be32(sig);
+  for(i = 0; i < count; i++){
+    fwcfgread(&f, sizeof(f));
+    if(strncmp(f.name, name, sizeof(f.name)) != 0)
+      continue;
+    size = be32(f.size);
+    if(size >= n)
+      size = n - 1;
+    outw(FW_CFG_CTL, (f.select[0]<<8) | f.select[1]);
+    fwcfgread(buf, size);
+    while(size > 0 && (buf[size-1] == '\n' || buf[size-1] == 0))
+      size--;
+    buf[size] = 0;
+    return size;
+  }
+  return -1;
+}
+
+// Boot parameter name as a decimal number, or def if it is
+// absent or not a number.
+int
+bootparamint(char *name, int def)
+{
+  char buf[16], *s;
+  int n;
+
+  if(bootparam(name, buf, sizeof(buf)) <= 0)
+    return def;
+  n = 0;
+  for(s = buf; *s; s++){
+    if(*s < '0' || *s > '9')
+      return def;
+    n = n*10 + *s - '0';
+  }
+  return n;
+}
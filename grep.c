@@ -3,6 +3,7 @@
 #include "types.h"
 #include "stat.h"
 #include "user.h"
+#include "fcntl.h"
 
 char buf[1024];
 int match(char*, char*);
@@ -57,6 +58,7 @@ main(int argc, char *argv[])
       printf(1, "grep: cannot open %s\n", argv[i]);
       exit();
     }
+    fadvise(fd, 0, 0, FADV_NOREUSE);  // one pass: keep the cache for others
     grep(pattern, fd);
     close(fd);
   }
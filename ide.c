@@ -1,4 +1,32 @@
-// Simple PIO-based (non-DMA) IDE driver code.
+// Simple IDE driver code, PIO-based or bus-master DMA.
+//
+// A request is a buf, or a chain of bufs through cnext holding
+// consecutive blocks, which goes to the disk as one command of
+// up to idemax sectors.
+//
+// By default the CPU moves the data through the data port
+// (PIO), IDEMULT sectors per interrupt.  With IDEDMA=1, or the
+// boot parameter opt/xv6/idedma (make qemu BOOTIDEDMA=1), and a
+// PCI IDE controller that can master the bus, like QEMU's
+// PIIX, the controller moves it instead: idestart() points the
+// controller at a table of the bufs' data (PRDs) and the CPU is
+// free until the one interrupt at the end, whatever the size,
+// so a command may be up to IDEDMAMAX sectors.
+//
+// Requests waiting for the disk are kept sorted by block and
+// served C-LOOK: the next one started is the first at or past
+// the end of the last, wrapping around to the lowest, so the
+// head sweeps across the disk in one direction instead of
+// thrashing between the log, inodes and data.  A request that
+// has waited IDEDEADLINE ticks goes next whatever its place,
+// so a busy region cannot starve the rest.
+//
+// A request about to start takes along the waiting requests
+// that continue it in the same direction, up to idemax
+// sectors (idemerge): log blocks or neighbouring home blocks
+// written by separate requests go to the disk as one command
+// and cost one interrupt.  The merged requests are linked
+// through qnext from idebusy.
 
 #include "types.h"
 #include "defs.h"
@@ -12,6 +40,7 @@
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
+#include "iostat.h"
 
 #define SECTOR_SIZE   512
 #define IDE_BSY       0x80
@@ -23,15 +52,53 @@
 #define IDE_CMD_WRITE 0x30
 #define IDE_CMD_RDMUL 0xc4
 #define IDE_CMD_WRMUL 0xc5
+#define IDE_CMD_SETMULT 0xc6
+#define IDE_CMD_RDDMA 0xc8
+#define IDE_CMD_WRDMA 0xca
 
-// idequeue points to the buf now being read/written to the disk.
-// idequeue->qnext points to the next buf to be processed.
+#define IDEMULT       16  // sectors per READ/WRITE MULTIPLE block
+#define IDEDMAMAX    128  // sectors per DMA command
+#define IDEDEADLINE   10  // ticks a request may be passed over
+
+#ifndef IDEDMA
+#define IDEDMA 0
+#endif
+
+// Bus-master registers of the primary channel, from idebm.
+#define BM_CMD        0
+#define BM_STAT       2
+#define BM_PRDT       4
+#define BM_START   0x01  // in BM_CMD
+#define BM_TOMEM   0x08  // in BM_CMD: the transfer writes memory
+#define BM_ERR     0x02  // in BM_STAT; write 1 to clear
+#define BM_INTR    0x04  // in BM_STAT; write 1 to clear
+
+// A physical region descriptor: one contiguous piece of a
+// transfer.  The table must not cross a 64K boundary.
+struct prd {
+  uint addr;
+  ushort len;
+  ushort flags;
+};
+#define PRD_EOT  0x8000  // last entry of the table
+
+// idebusy points to the buf now being read/written to the disk.
+// idequeue holds the bufs waiting for it, through qnext, sorted
+// by (dev, blockno); idedev and idepos are the device and block
+// just past the last request started.
 // You must hold idelock while manipulating queue.
 
 static struct spinlock idelock;
+static struct buf *idebusy;
 static struct buf *idequeue;
+static uint idedev, idepos;
+static int idedepth;  // requests queued or busy
+static struct iostat idest;
 
 static int havedisk1;
+static int idemax = IDEMULT;  // sectors per command
+static ushort idebm;          // bus-master registers, or 0: PIO
+static struct prd *ideprd;    // the PRD table, one page
 static void idestart(struct buf*);
 
 // Wait for IDE disk to become ready.
@@ -47,6 +114,33 @@ idewait(int checkerr)
   return 0;
 }
 
+// Find a PCI IDE controller that can master the bus and set
+// it up to move our data; if there is none, stay with PIO.
+static void
+idedmainit(void)
+{
+  int bdf;
+  uint bar;
+
+  // Class 1 (storage), subclass 1 (IDE); bit 7 of the
+  // programming interface says it can master the bus.
+  if((bdf = pcifindclass(0x01, 0x01)) < 0 ||
+     (pciread(bdf, 0x08) & 0x8000) == 0){
+    cprintf("ide: no bus-master controller, using PIO\n");
+    return;
+  }
+  bar = pciread(bdf, 0x20);  // BAR4: the bus-master registers
+  if((bar & 1) == 0 || (ideprd = (struct prd*)kalloc()) == 0){
+    cprintf("ide: cannot set up DMA, using PIO\n");
+    return;
+  }
+  // Enable I/O decoding and bus mastering.
+  pciwrite(bdf, 0x04, (pciread(bdf, 0x04) & 0xffff) | 0x5);
+  idebm = bar & 0xfffc;
+  idemax = IDEDMAMAX;
+  cprintf("ide: bus-master DMA\n");
+}
+
 void
 ideinit(void)
 {
@@ -65,35 +159,173 @@ ideinit(void)
     }
   }
 
+  // Let READ/WRITE MULTIPLE move IDEMULT sectors per interrupt.
+  if(havedisk1){
+    outb(0x3f6, 2);  // no interrupt for this command
+    outb(0x1f2, IDEMULT);
+    outb(0x1f7, IDE_CMD_SETMULT);
+    idewait(0);
+  }
+  if(MAXRUN*(BSIZE/SECTOR_SIZE) > IDEMULT)
+    panic("ideinit: MAXRUN");
+
   // Switch back to disk 0.
   outb(0x1f6, 0xe0 | (0<<4));
+
+  if(havedisk1 && bootparamint("opt/xv6/idedma", IDEDMA))
+    idedmainit();
+}
+
+// Count v in log2 histogram h.
+static void
+iohist(uint *h, uint v)
+{
+  int i;
+
+  for(i = 0; i < NIOHIST-1 && (v >> (i+1)) != 0; i++)
+    ;
+  h[i]++;
 }
 
-// Start the request for b.  Caller must hold idelock.
+// Append to request b the waiting requests that continue it in
+// the same direction, up to idemax sectors in all.
+// Caller must hold idelock.
+static void
+idemerge(struct buf *b)
+{
+  struct buf **pp, *r, *c, *tail;
+  int n, m;
+
+  n = 0;
+  for(c = b; c != 0; c = c->cnext)
+    n++;
+  tail = b;
+  // idequeue is sorted, so each continuation follows the last.
+  for(pp = &idequeue; *pp; ){
+    r = *pp;
+    if(r->dev != b->dev || r->blockno != b->blockno + n ||
+       (r->flags & B_DIRTY) != (b->flags & B_DIRTY)){
+      pp = &r->qnext;
+      continue;
+    }
+    m = 0;
+    for(c = r; c != 0; c = c->cnext)
+      m++;
+    if((n + m) * (BSIZE/SECTOR_SIZE) > idemax)
+      break;
+    *pp = r->qnext;
+    r->qnext = 0;
+    tail->qnext = r;
+    tail = r;
+    n += m;
+    idest.merged++;
+  }
+}
+
+// Take the next request to start off idequeue: the oldest if it
+// has waited IDEDEADLINE ticks, else the first at or past the
+// head, else the first.  Merge what continues it.
+// Caller must hold idelock.
+static struct buf*
+idenext(void)
+{
+  struct buf **pp, **old, **next, *b;
+
+  old = next = 0;
+  for(pp = &idequeue; *pp; pp = &(*pp)->qnext){
+    b = *pp;
+    if(old == 0 || (int)(b->qtick - (*old)->qtick) < 0)
+      old = pp;
+    if(next == 0 && (b->dev > idedev || (b->dev == idedev && b->blockno >= idepos)))
+      next = pp;
+  }
+  if(old == 0)
+    return 0;
+  if(next == 0)
+    next = &idequeue;  // wrap around
+  if(old != next && ticks - (*old)->qtick >= IDEDEADLINE){
+    idest.deadlines++;
+    next = old;
+  }
+  b = *next;
+  *next = b->qnext;
+  b->qnext = 0;
+  idemerge(b);
+  return b;
+}
+
+// Start the request for b, and those merged with it.
+// Caller must hold idelock.
 static void
 idestart(struct buf *b)
 {
+  struct buf *r, *c;
+  int n;
+  uint seek;
+
   if(b == 0)
     panic("idestart");
-  if(b->blockno >= FSSIZE)
+  n = 0;
+  for(r = b; r != 0; r = r->qnext){
+    for(c = r; c != 0; c = c->cnext){
+      if(c->dev != b->dev || c->blockno != b->blockno + n)
+        panic("idestart: chain");
+      n++;
+    }
+  }
+  if(b->blockno + n > FSSIZE)
     panic("incorrect blockno");
   int sector_per_block =  BSIZE/SECTOR_SIZE;
   int sector = b->blockno * sector_per_block;
-  int read_cmd = (sector_per_block == 1) ? IDE_CMD_READ :  IDE_CMD_RDMUL;
-  int write_cmd = (sector_per_block == 1) ? IDE_CMD_WRITE : IDE_CMD_WRMUL;
+  int nsector = n * sector_per_block;
+  int read_cmd = (nsector == 1) ? IDE_CMD_READ :  IDE_CMD_RDMUL;
+  int write_cmd = (nsector == 1) ? IDE_CMD_WRITE : IDE_CMD_WRMUL;
 
-  if (sector_per_block > 7) panic("idestart");
+  if (nsector > idemax) panic("idestart");
+
+  // The seek from the end of the last request, on one device.
+  seek = b->dev != idedev ? 0 :
+    b->blockno > idepos ? b->blockno - idepos : idepos - b->blockno;
+  idest.starts++;
+  idest.seek += seek;
+  iohist(idest.seekhist, seek);
+  idedev = b->dev;
+  idepos = b->blockno + n;
+
+  // For DMA, describe each buf's data to the controller and
+  // set the direction; it starts after the drive's command.
+  if(idebm){
+    n = 0;
+    for(r = b; r != 0; r = r->qnext){
+      for(c = r; c != 0; c = c->cnext){
+        ideprd[n].addr = V2P(c->data);
+        ideprd[n].len = BSIZE;
+        ideprd[n].flags = 0;
+        n++;
+      }
+    }
+    ideprd[n-1].flags = PRD_EOT;
+    outb(idebm + BM_CMD, 0);
+    outb(idebm + BM_STAT, BM_ERR | BM_INTR);
+    outl(idebm + BM_PRDT, V2P(ideprd));
+    outb(idebm + BM_CMD, (b->flags & B_DIRTY) ? 0 : BM_TOMEM);
+  }
 
   idewait(0);
   outb(0x3f6, 0);  // generate interrupt
-  outb(0x1f2, sector_per_block);  // number of sectors
+  outb(0x1f2, nsector);  // number of sectors
   outb(0x1f3, sector & 0xff);
   outb(0x1f4, (sector >> 8) & 0xff);
   outb(0x1f5, (sector >> 16) & 0xff);
   outb(0x1f6, 0xe0 | ((b->dev&1)<<4) | ((sector>>24)&0x0f));
-  if(b->flags & B_DIRTY){
+  if(idebm){
+    outb(0x1f7, (b->flags & B_DIRTY) ? IDE_CMD_WRDMA : IDE_CMD_RDDMA);
+    outb(idebm + BM_CMD, inb(idebm + BM_CMD) | BM_START);
+  } else if(b->flags & B_DIRTY){
     outb(0x1f7, write_cmd);
-    outsl(0x1f0, b->data, BSIZE/4);
+    for(r = b; r != 0; r = r->qnext)
+      for(c = r; c != 0; c = c->cnext)
+        outsl(0x1f0, c->data, BSIZE/4);
   } else {
     outb(0x1f7, read_cmd);
   }
@@ -103,66 +335,138 @@ idestart(struct buf *b)
 void
 ideintr(void)
 {
-  struct buf *b;
+  struct buf *b, *r, *c, *next, *async;
+  uchar st;
 
-  // First queued buffer is the active request.
   acquire(&idelock);
 
-  if((b = idequeue) == 0){
+  if((b = idebusy) == 0){
     release(&idelock);
     return;
   }
-  idequeue = b->qnext;
+  idebusy = 0;
 
-  // Read data if needed.
-  if(!(b->flags & B_DIRTY) && idewait(1) >= 0)
-    insl(0x1f0, b->data, BSIZE/4);
+  if(idebm){
+    // The controller has moved the data; stop it and clear
+    // its status.
+    st = inb(idebm + BM_STAT);
+    outb(idebm + BM_CMD, 0);
+    outb(idebm + BM_STAT, BM_ERR | BM_INTR);
+    if(idewait(1) < 0 || (st & BM_ERR))
+      panic("ideintr: DMA error");
+  } else if(!(b->flags & B_DIRTY) && idewait(1) >= 0){
+    // Read data if needed, scattering it to the merged requests.
+    for(r = b; r != 0; r = r->qnext)
+      for(c = r; c != 0; c = c->cnext)
+        insl(0x1f0, c->data, BSIZE/4);
+  }
 
-  // Wake process waiting for this buf.
-  b->flags |= B_VALID;
-  b->flags &= ~B_DIRTY;
-  wakeup(b);
+  // Wake process waiting for these bufs.  A request is all
+  // synchronous or all asynchronous; collect the asynchronous
+  // ones through qnext.
+  async = 0;
+  for(r = b; r != 0; r = next){
+    next = r->qnext;
+    r->qnext = 0;
+    idedepth--;
+    for(c = r; c != 0; c = c->cnext){
+      c->flags |= B_VALID;
+      c->flags &= ~B_DIRTY;
+      if(!(r->flags & B_ASYNC))
+        wakeup(c);
+    }
+    if(r->flags & B_ASYNC){
+      r->qnext = async;
+      async = r;
+    }
+  }
 
   // Start disk on next buf in queue.
-  if(idequeue != 0)
-    idestart(idequeue);
+  if((idebusy = idenext()) != 0)
+    idestart(idebusy);
 
   release(&idelock);
+
+  // Nobody waits for an asynchronous request; hand it back.
+  while((r = async) != 0){
+    async = r->qnext;
+    r->qnext = 0;
+    for(c = r; c != 0; c = next){
+      next = c->cnext;
+      c->cnext = 0;
+      c->flags &= ~B_ASYNC;
+      biodone(c);
+    }
+  }
 }
 
 //PAGEBREAK!
-// Sync buf with disk.
+// Queue a request to sync buf with disk, and return.
 // If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
 // Else if B_VALID is not set, read buf from disk, set B_VALID.
+// If B_ASYNC is set, ideintr() calls biodone() on each buf when
+// it finishes; otherwise the caller waits with ideiowait().
+// b->cnext may chain bufs for the following blocks, all locked
+// and all to be read or all to be written.
 void
-iderw(struct buf *b)
+idesubmit(struct buf *b)
 {
   struct buf **pp;
 
   if(!holdingsleep(&b->lock))
-    panic("iderw: buf not locked");
+    panic("idesubmit: buf not locked");
   if((b->flags & (B_VALID|B_DIRTY)) == B_VALID)
-    panic("iderw: nothing to do");
+    panic("idesubmit: nothing to do");
   if(b->dev != 0 && !havedisk1)
-    panic("iderw: ide disk 1 not present");
+    panic("idesubmit: ide disk 1 not present");
 
   acquire(&idelock);  //DOC:acquire-lock
 
-  // Append b to idequeue.
-  b->qnext = 0;
+  idest.reqs++;
+  idest.depth += idedepth;
+  iohist(idest.depthhist, idedepth);
+  idedepth++;
+
+  // Insert b into idequeue, in block order.
+  b->qtick = ticks;
   for(pp=&idequeue; *pp; pp=&(*pp)->qnext)  //DOC:insert-queue
-    ;
+    if((*pp)->dev > b->dev || ((*pp)->dev == b->dev && (*pp)->blockno > b->blockno))
+      break;
+  b->qnext = *pp;
   *pp = b;
 
   // Start disk if necessary.
-  if(idequeue == b)
-    idestart(b);
+  if(idebusy == 0){
+    idebusy = idenext();
+    idestart(idebusy);
+  }
 
-  // Wait for request to finish.
+  release(&idelock);
+}
+
+// Wait for the request that holds locked buf b, submitted
+// without B_ASYNC, to finish.
+void
+ideiowait(struct buf *b)
+{
+  if(!holdingsleep(&b->lock))
+    panic("ideiowait: buf not locked");
+
+  acquire(&idelock);
   while((b->flags & (B_VALID|B_DIRTY)) != B_VALID){
     sleep(b, &idelock);
   }
+  release(&idelock);
+}
 
-
+// Copy the disk request counters to *st; clear them if reset
+// is set.
+void
+idestat(struct iostat *st, int reset)
+{
+  acquire(&idelock);
+  *st = idest;
+  if(reset)
+    memset(&idest, 0, sizeof(idest));
   release(&idelock);
 }
@@ -0,0 +1,48 @@
+// Print the disk request counters.
+// iostat -r also clears them after printing.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "iostat.h"
+
+// Print the nonzero buckets of log2 histogram h.
+void
+phist(char *what, uint *h)
+{
+  int i;
+
+  printf(1, "%s:\n", what);
+  for(i = 0; i < NIOHIST; i++){
+    if(h[i] != 0)
+      printf(1, "  2^%d%s\t%d\n", i, i == NIOHIST-1 ? "+" : "", h[i]);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct iostat st;
+  int reset;
+
+  reset = argc > 1 && strcmp(argv[1], "-r") == 0;
+  if(argc > 2 || (argc == 2 && !reset)){
+    printf(2, "usage: iostat [-r]\n");
+    exit();
+  }
+  if(iostat(&st, reset) < 0){
+    printf(2, "iostat: failed\n");
+    exit();
+  }
+
+  printf(1, "requests %d, %d merged, commands %d, %d out of order for their deadline\n",
+         st.reqs, st.merged, st.starts, st.deadlines);
+  if(st.reqs > 0)
+    printf(1, "queue depth found %d.%d on average\n",
+           st.depth / st.reqs, st.depth * 10 / st.reqs % 10);
+  if(st.starts > 0)
+    printf(1, "seek %d blocks on average\n", st.seek / st.starts);
+  phist("queue depth found", st.depthhist);
+  phist("blocks sought", st.seekhist);
+  exit();
+}
@@ -0,0 +1,18 @@
+// Disk request counters, filled in by the iostat system call.
+// Both the kernel and user programs use this header file.
+
+// Histogram bucket i counts values of 2^i to 2^(i+1)-1
+// (bucket 0 also counts 0); the last bucket counts everything
+// larger.
+#define NIOHIST 12
+
+struct iostat {
+  uint reqs;        // requests queued
+  uint starts;      // disk commands started
+  uint merged;      // requests merged into another's command
+  uint depth;       // sum of the queue depths requests found
+  uint seek;        // sum of the blocks the head moved to start them
+  uint deadlines;   // started out of order, having waited too long
+  uint depthhist[NIOHIST]; // requests by the queue depth they found
+  uint seekhist[NIOHIST];  // started requests by blocks sought
+};
@@ -27,7 +27,24 @@
 //   block B
 //   block C
 //   ...
-// Log appends are synchronous.
+// Log appends are synchronous, but go to the disk together.
+// Log blocks never enter the buffer cache (bgetraw, BH_LOG):
+// they are written once per commit and read only by recovery,
+// and would only push out blocks worth keeping.
+//
+// Installing a committed transaction only copies its blocks to
+// their home buffers and leaves them to the buffer cache's
+// write-back (bdwrite), so the committing process does not wait
+// for them.  Until they are on disk the header still describes
+// the transaction, and a crash just installs it again.  The
+// next begin_op() finishes the job first (checkpoint): the new
+// transaction must neither change those buffers before they
+// are written nor overwrite the log before it is erased.  The
+// checkpoint forces only the blocks the header names (bflushn),
+// and waits for none the flusher has already written; a stream
+// of transactions still pays for each one's install at the next
+// begin_op(), at most LOGSIZE block writes sorted into runs,
+// which is the price of having one log to commit into.
 
 // Contents of the header block, used for both the on-disk header block
 // and to keep track in memory of logged block# before commit.
@@ -42,6 +59,7 @@ struct log {
   int size;
   int outstanding; // how many FS sys calls are executing.
   int committing;  // in commit(), please wait.
+  struct logheader inst; // last commit, until checkpoint() erases it
   int dev;
   struct logheader lh;
 };
@@ -65,19 +83,36 @@ initlog(int dev)
   recover_from_log();
 }
 
-// Copy committed blocks from log to their home location
+// Copy committed blocks from log to their home location;
+// the buffer cache writes them back later.  After a commit the
+// home buffers, pinned by log_write(), already hold the data.
 static void
-install_trans(void)
+install_trans(int recovering)
 {
-  int tail;
+  int tail, i, n;
+  struct buf *lbufs[MAXRUN];
 
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
-    struct buf *dbuf = bread(log.dev, log.lh.block[tail]); // read dst
-    memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
-    bwrite(dbuf);  // write dst to disk
-    brelse(lbuf);
-    brelse(dbuf);
+  for (tail = 0; tail < log.lh.n; tail += n) {
+    n = log.lh.n - tail < MAXRUN ? log.lh.n - tail : MAXRUN;
+    if (recovering) {
+      // Start reading the home blocks, so that the disk has
+      // them queued while the log blocks come in.
+      for (i = 0; i < n; i++)
+        bprefetch(log.dev, log.lh.block[tail+i], 1, BH_META);
+    }
+    if (recovering)
+      breadn(log.dev, log.start+tail+1, n, lbufs, BH_LOG); // read log blocks
+    for (i = 0; i < n; i++) {
+      // The class is a guess when recovering: most logged
+      // blocks are metadata.
+      struct buf *dbuf = bread(log.dev, log.lh.block[tail+i], BH_META); // read dst
+      if (recovering) {
+        memmove(dbuf->data, lbufs[i]->data, BSIZE);  // copy block to dst
+        brelse(lbufs[i]);
+      }
+      bdwrite(dbuf);  // write dst to disk, later
+      brelse(dbuf);
+    }
   }
 }
 
@@ -85,7 +120,7 @@ install_trans(void)
 static void
 read_head(void)
 {
-  struct buf *buf = bread(log.dev, log.start);
+  struct buf *buf = bread(log.dev, log.start, BH_LOG);
   struct logheader *lh = (struct logheader *) (buf->data);
   int i;
   log.lh.n = lh->n;
@@ -101,9 +136,10 @@ read_head(void)
 static void
 write_head(void)
 {
-  struct buf *buf = bread(log.dev, log.start);
+  struct buf *buf = bgetraw(log.dev, log.start);
   struct logheader *hb = (struct logheader *) (buf->data);
   int i;
+  memset(buf->data, 0, BSIZE);
   hb->n = log.lh.n;
   for (i = 0; i < log.lh.n; i++) {
     hb->block[i] = log.lh.block[i];
@@ -116,11 +152,21 @@ static void
 recover_from_log(void)
 {
   read_head();
-  install_trans(); // if committed, copy from log to disk
+  install_trans(1); // if committed, copy from log to disk
+  bflush();
   log.lh.n = 0;
   write_head(); // clear the log
 }
 
+// Finish installing the last committed transaction: once its
+// blocks are on disk the log can be erased.
+static void
+checkpoint(void)
+{
+  bflushn(log.dev, log.inst.block, log.inst.n);
+  write_head();    // Erase the transaction from the log
+}
+
 // called at the start of each FS system call.
 void
 begin_op(void)
@@ -129,6 +175,15 @@ begin_op(void)
   while(1){
     if(log.committing){
       sleep(&log, &log.lock);
+    } else if(log.inst.n > 0){
+      // no FS op is running; finish the last commit.
+      log.committing = 1;
+      release(&log.lock);
+      checkpoint();
+      acquire(&log.lock);
+      log.inst.n = 0;
+      log.committing = 0;
+      wakeup(&log);
     } else if(log.lh.n + (log.outstanding+1)*MAXOPBLOCKS > LOGSIZE){
       // this op might exhaust log space; wait for commit.
       sleep(&log, &log.lock);
@@ -177,16 +232,18 @@ end_op(void)
 static void
 write_log(void)
 {
+  struct buf *to[LOGSIZE];
   int tail;
 
   for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *to = bread(log.dev, log.start+tail+1); // log block
-    struct buf *from = bread(log.dev, log.lh.block[tail]); // cache block
-    memmove(to->data, from->data, BSIZE);
-    bwrite(to);  // write the log
+    to[tail] = bgetraw(log.dev, log.start+tail+1); // log block
+    struct buf *from = bread(log.dev, log.lh.block[tail], BH_META); // cache block, pinned
+    memmove(to[tail]->data, from->data, BSIZE);
     brelse(from);
-    brelse(to);
   }
+  bwritev(to, log.lh.n);  // write the log
+  for (tail = 0; tail < log.lh.n; tail++)
+    brelse(to[tail]);
 }
 
 static void
@@ -195,9 +252,9 @@ commit()
   if (log.lh.n > 0) {
     write_log();     // Write modified blocks from cache to log
     write_head();    // Write header to disk -- the real commit
-    install_trans(); // Now install writes to home locations
+    install_trans(0); // Now install writes to home locations
+    log.inst = log.lh;   // checkpoint() erases the transaction
     log.lh.n = 0;
-    write_head();    // Erase the transaction from the log
   }
 }
 
@@ -228,7 +285,7 @@ log_write(struct buf *b)
   log.lh.block[i] = b->blockno;
   if (i == log.lh.n)
     log.lh.n++;
-  b->flags |= B_DIRTY; // prevent eviction
+  b->flags |= B_DIRTY | B_MODIFIED; // B_DIRTY prevents eviction
   release(&log.lock);
 }
 
@@ -12,11 +12,13 @@
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
+#include "iostat.h"
 
 extern uchar _binary_fs_img_start[], _binary_fs_img_size[];
 
 static int disksize;
 static uchar *memdisk;
+static struct iostat idest;  // no queue, no seeks: only counts
 
 void
 ideinit(void)
@@ -35,20 +37,29 @@ ideintr(void)
 // Sync buf with disk.
 // If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
 // Else if B_VALID is not set, read buf from disk, set B_VALID.
+// The copy is done at once, so requests finish here and
+// B_ASYNC ones are handed to biodone() before returning.
 void
-iderw(struct buf *b)
+idesubmit(struct buf *b)
 {
   uchar *p;
 
+  // Do the rest of a multi-block chain first, since b's
+  // completion may hand the chain back.
+  if(b->cnext)
+    idesubmit(b->cnext);
+
   if(!holdingsleep(&b->lock))
-    panic("iderw: buf not locked");
+    panic("idesubmit: buf not locked");
   if((b->flags & (B_VALID|B_DIRTY)) == B_VALID)
-    panic("iderw: nothing to do");
+    panic("idesubmit: nothing to do");
   if(b->dev != 1)
-    panic("iderw: request not for disk 1");
+    panic("idesubmit: request not for disk 1");
   if(b->blockno >= disksize)
-    panic("iderw: block out of range");
+    panic("idesubmit: block out of range");
 
+  idest.reqs++;
+  idest.starts++;
   p = memdisk + b->blockno*BSIZE;
 
   if(b->flags & B_DIRTY){
@@ -57,4 +68,27 @@ iderw(struct buf *b)
   } else
     memmove(b->data, p, BSIZE);
   b->flags |= B_VALID;
+  if(b->flags & B_ASYNC){
+    b->cnext = 0;
+    b->flags &= ~B_ASYNC;
+    biodone(b);
+  }
+}
+
+// Nothing to wait for: idesubmit() has already finished b.
+void
+ideiowait(struct buf *b)
+{
+  if((b->flags & (B_VALID|B_DIRTY)) != B_VALID)
+    panic("ideiowait");
+}
+
+// Copy the disk request counters to *st; clear them if reset
+// is set.
+void
+idestat(struct iostat *st, int reset)
+{
+  *st = idest;
+  if(reset)
+    memset(&idest, 0, sizeof(idest));
 }
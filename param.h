@@ -9,9 +9,17 @@
 #define MAXARG       32  // max exec arguments
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
-#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define MBUF         5  // size of disk block cache
-#define SBUF         2  
-#define FSSIZE       1000  // size of file system in blocks
-#define GBUF         3  // size of disk block cache
+#define NBUF         (LOGSIZE*3)  // minimum size of disk block cache
+#define BCFRAC      512  // disk block cache gets 1/BCFRAC of free memory
+#define BCSMALL      10  // percent of the cache in the probationary queue
+#define BCDATA       75  // percent of the cache file data may fill
+#define BCADAPT       1  // 1: the probationary share adapts at run time
+#define NPIN         16  // blocks bpin() can keep cached for good
+#define NFRONT        4  // recently released buffers kept per CPU
+#define FSSIZE       2000  // size of file system in blocks
+#define RAMAX        16  // most blocks read ahead of a sequential reader
+#define MAXRUN        8  // most blocks in one multi-block disk request
+#define BDIRTYAGE   100  // ticks a delayed write may wait for the flusher
+#define BDIRTYMAX    32  // delayed writes that wake the flusher at once
+#define NTRACE    1024  // trace records kept per CPU (BTRACE=1)
 
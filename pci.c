@@ -0,0 +1,69 @@
+// PCI configuration space, through the legacy I/O ports.
+//
+// Only enough to find a device and set it up.  A function is
+// named by its bus, device and function numbers packed as
+// bus<<8 | dev<<3 | func (bdf); only bus 0 is searched, which
+// is where QEMU puts its devices.
+
+#include "types.h"
+#include "defs.h"
+#include "x86.h"
+
+#define PCI_ADDR    0xcf8
+#define PCI_DATA    0xcfc
+
+#define PCI_ID      0x00  // vendor id, device id
+#define PCI_CLASS   0x08  // revision, interface, subclass, class
+#define PCI_HEADER  0x0c  // header type in bits 16-23
+
+// Read the 32-bit register at off of function bdf.
+uint
+pciread(int bdf, int off)
+{
+  outl(PCI_ADDR, 0x80000000 | bdf<<8 | (off & 0xfc));
+  return inl(PCI_DATA);
+}
+
+// Write the 32-bit register at off of function bdf.
+void
+pciwrite(int bdf, int off, uint v)
+{
+  outl(PCI_ADDR, 0x80000000 | bdf<<8 | (off & 0xfc));
+  outl(PCI_DATA, v);
+}
+
+// Return the first function on bus 0 whose register off,
+// masked by mask, equals v; or -1.
+static int
+pcimatch(int off, uint mask, uint v)
+{
+  int dev, func, nfunc;
+
+  for(dev = 0; dev < 32; dev++){
+    if((pciread(dev<<3, PCI_ID) & 0xffff) == 0xffff)
+      continue;
+    // Bit 7 of the header type marks a multi-function device.
+    nfunc = pciread(dev<<3, PCI_HEADER) & 0x800000 ? 8 : 1;
+    for(func = 0; func < nfunc; func++){
+      if((pciread(dev<<3 | func, PCI_ID) & 0xffff) == 0xffff)
+        continue;
+      if((pciread(dev<<3 | func, off) & mask) == v)
+        return dev<<3 | func;
+    }
+  }
+  return -1;
+}
+
+// The function with the given vendor and device ids, or -1.
+int
+pcifind(uint vendor, uint device)
+{
+  return pcimatch(PCI_ID, 0xffffffff, device<<16 | vendor);
+}
+
+// The function of the given class and subclass, or -1.
+int
+pcifindclass(uint class, uint subclass)
+{
+  return pcimatch(PCI_CLASS, 0xffff0000, class<<24 | subclass<<16);
+}
@@ -0,0 +1,16 @@
+// Write the buffer cache's delayed writes to disk and record
+// its hot set, so that the next boot starts with a warm cache.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+int
+main(int argc, char *argv[])
+{
+  if(sync() < 0){
+    printf(2, "sync: failed\n");
+    exit();
+  }
+  exit();
+}
@@ -103,6 +103,11 @@ extern int sys_unlink(void);
 extern int sys_wait(void);
 extern int sys_write(void);
 extern int sys_uptime(void);
+extern int sys_bcstat(void);
+extern int sys_btrace(void);
+extern int sys_fadvise(void);
+extern int sys_sync(void);
+extern int sys_iostat(void);
 
 static int (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -126,6 +131,11 @@ static int (*syscalls[])(void) = {
 [SYS_link]    sys_link,
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
+[SYS_bcstat]  sys_bcstat,
+[SYS_btrace]  sys_btrace,
+[SYS_fadvise] sys_fadvise,
+[SYS_sync]    sys_sync,
+[SYS_iostat]  sys_iostat,
 };
 
 void
@@ -20,3 +20,8 @@
 #define SYS_link   19
 #define SYS_mkdir  20
 #define SYS_close  21
+#define SYS_bcstat 22
+#define SYS_btrace 23
+#define SYS_fadvise 24
+#define SYS_sync   25
+#define SYS_iostat 26
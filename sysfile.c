@@ -15,6 +15,9 @@
 #include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "bcstat.h"
+#include "trace.h"
+#include "iostat.h"
 
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
@@ -172,7 +175,7 @@ isdirempty(struct inode *dp)
   struct dirent de;
 
   for(off=2*sizeof(de); off<dp->size; off+=sizeof(de)){
-    if(readi(dp, (char*)&de, off, sizeof(de)) != sizeof(de))
+    if(readi(dp, (char*)&de, off, sizeof(de), FADV_NORMAL) != sizeof(de))
       panic("isdirempty: readi");
     if(de.inum != 0)
       return 0;
@@ -442,3 +445,80 @@ sys_pipe(void)
   fd[1] = fd1;
   return 0;
 }
+
+// Copy the buffer cache counters out to user space,
+// clearing them afterwards if the second argument is non-zero.
+int
+sys_bcstat(void)
+{
+  struct bcstat *st;
+  int reset;
+
+  if(argptr(0, (void*)&st, sizeof(*st)) < 0 || argint(1, &reset) < 0)
+    return -1;
+  bstat(st, reset);
+  return 0;
+}
+
+// Copy the disk request counters out to user space,
+// clearing them afterwards if the second argument is non-zero.
+int
+sys_iostat(void)
+{
+  struct iostat *st;
+  int reset;
+
+  if(argptr(0, (void*)&st, sizeof(*st)) < 0 || argint(1, &reset) < 0)
+    return -1;
+  idestat(st, reset);
+  return 0;
+}
+
+// Advise how the n bytes at off of the file open as fd, or all
+// of it from off if n is 0, will be read: one of FADV_*.  The
+// advice holds for this open file, not for others of the inode.
+int
+sys_fadvise(void)
+{
+  struct file *f;
+  int off, n, advice, r;
+
+  if(argfd(0, 0, &f) < 0 || argint(1, &off) < 0 || argint(2, &n) < 0 ||
+     argint(3, &advice) < 0 || off < 0 || n < 0)
+    return -1;
+  if(f->type != FD_INODE)
+    return -1;
+  ilock(f->ip);
+  r = iadvise(f->ip, off, n, advice);
+  iunlock(f->ip);
+  if(r == 0 && advice != FADV_WILLNEED)
+    f->advice = advice;
+  return r;
+}
+
+// Write delayed writes to disk and save the buffer cache's
+// hot set, to warm the cache at the next boot.
+int
+sys_sync(void)
+{
+  fssync(ROOTDEV);
+  return 0;
+}
+
+// Drain up to n kernel trace records into the user buffer.
+// Returns the number drained, or -1 if the kernel was built
+// without tracepoints.
+int
+sys_btrace(void)
+{
+  struct trace *t;
+  int n;
+
+  if(argint(1, &n) < 0 || n < 0)
+    return -1;
+  if(n > NCPU*NTRACE)
+    n = NCPU*NTRACE;
+  if(argptr(0, (void*)&t, n*sizeof(*t)) < 0)
+    return -1;
+  return tracedrain(t, n);
+}
@@ -0,0 +1,93 @@
+// Kernel tracepoints.
+//
+// TRACE(ev, dev, blockno, arg) appends a struct trace to a ring
+// belonging to the current CPU, so recording never contends with
+// other CPUs.  When a ring is full the oldest record is overwritten.
+// btrace() drains every ring into user space.
+//
+// Tracing costs nothing unless the kernel is built with
+// "make BTRACE=1": TRACE() compiles away (its arguments are
+// still type-checked) and the rings are not allocated.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "spinlock.h"
+#include "trace.h"
+
+#ifdef BTRACE
+
+struct {
+  struct spinlock lock;
+  uint head;       // next record written
+  uint tail;       // next record drained
+  struct trace rec[NTRACE];
+} tracebuf[NCPU];
+
+void
+traceinit(void)
+{
+  int i;
+
+  for(i = 0; i < NCPU; i++)
+    initlock(&tracebuf[i].lock, "trace");
+}
+
+void
+trace(int ev, uint dev, uint blockno, uint arg)
+{
+  struct trace *t;
+  int c;
+
+  pushcli();
+  c = cpuid();
+  acquire(&tracebuf[c].lock);
+  if(tracebuf[c].head - tracebuf[c].tail == NTRACE)
+    tracebuf[c].tail++;
+  t = &tracebuf[c].rec[tracebuf[c].head++ % NTRACE];
+  t->tick = ticks;
+  t->ev = ev;
+  t->cpu = c;
+  t->dev = dev;
+  t->blockno = blockno;
+  t->arg = arg;
+  release(&tracebuf[c].lock);
+  popcli();
+}
+
+// Move up to n records, oldest first per CPU, to dst.
+// Returns the number of records moved.
+int
+tracedrain(struct trace *dst, int n)
+{
+  int i, c;
+
+  i = 0;
+  for(c = 0; c < NCPU && i < n; c++){
+    acquire(&tracebuf[c].lock);
+    while(tracebuf[c].tail != tracebuf[c].head && i < n)
+      dst[i++] = tracebuf[c].rec[tracebuf[c].tail++ % NTRACE];
+    release(&tracebuf[c].lock);
+  }
+  return i;
+}
+
+#else
+
+void
+traceinit(void)
+{
+}
+
+void
+trace(int ev, uint dev, uint blockno, uint arg)
+{
+}
+
+int
+tracedrain(struct trace *dst, int n)
+{
+  return -1;
+}
+
+#endif
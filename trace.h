@@ -0,0 +1,18 @@
+// Fixed-size binary trace records, drained by the btrace system call.
+// Both the kernel and user programs use this header file.
+struct trace {
+  uint tick;     // ticks when recorded
+  ushort ev;     // TR_*
+  ushort cpu;    // CPU that recorded it
+  uint dev;
+  uint blockno;
+  uint arg;      // event specific, see below
+};
+
+#define TR_READ   1  // bread(); arg 1 if it went to disk
+#define TR_WRITE  2  // block written; arg is the length of its run
+#define TR_HIT    3  // lookup found the block; arg is its queue
+#define TR_MISS   4  // lookup missed; arg 1 if it was a ghost hit
+#define TR_EVICT  5  // block replaced; arg is the queue it left
+#define TR_PREFETCH 6  // read-ahead started a disk read
+#define TR_ACCESS 7  // brelse(); arg 1 if the holder wrote the block
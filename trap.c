@@ -13,6 +13,7 @@ struct gatedesc idt[256];
 extern uint vectors[];  // in vectors.S: array of 256 entry pointers
 struct spinlock tickslock;
 uint ticks;
+int diskirq = -1;  // a PCI disk's interrupt line, set by its driver
 
 void
 tvinit(void)
@@ -80,6 +81,11 @@ trap(struct trapframe *tf)
 
   //PAGEBREAK: 13
   default:
+    if(diskirq >= 0 && tf->trapno == T_IRQ0 + diskirq){
+      ideintr();
+      lapiceoi();
+      break;
+    }
     if(myproc() == 0 || (tf->cs&3) == 0){
       // In kernel, it must be our mistake.
       cprintf("unexpected trap %d from cpu %d eip %x (cr2=0x%x)\n",
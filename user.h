@@ -1,5 +1,8 @@
 struct stat;
 struct rtcdate;
+struct bcstat;
+struct trace;
+struct iostat;
 
 // system calls
 int fork(void);
@@ -23,6 +26,11 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
+int bcstat(struct bcstat*, int);
+int btrace(struct trace*, int);
+int fadvise(int, int, int, int);
+int sync(void);
+int iostat(struct iostat*, int);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -7,6 +7,7 @@
 #include "syscall.h"
 #include "traps.h"
 #include "memlayout.h"
+#include "bcstat.h"
 
 char buf[8192];
 char name[3];
@@ -1737,6 +1738,50 @@ void argptest()
   printf(1, "arg test passed\n");
 }
 
+// does the buffer cache count a re-read block as a hit,
+// and does bcstat(..., 1) clear the counters?
+void
+bcstattest(void)
+{
+  struct bcstat st;
+  int fd, i;
+
+  printf(stdout, "bcstat test\n");
+
+  fd = open("bcstat.tmp", O_CREATE|O_RDWR);
+  if(fd < 0 || write(fd, buf, BSIZE) != BSIZE){
+    printf(stdout, "bcstat: create failed\n");
+    exit();
+  }
+  close(fd);
+
+  if(bcstat(&st, 1) < 0){
+    printf(stdout, "bcstat: bcstat failed\n");
+    exit();
+  }
+  for(i = 0; i < 2; i++){
+    fd = open("bcstat.tmp", O_RDONLY);
+    if(fd < 0 || read(fd, buf, BSIZE) != BSIZE){
+      printf(stdout, "bcstat: read failed\n");
+      exit();
+    }
+    close(fd);
+  }
+  bcstat(&st, 1);
+  if(st.mhits + st.shits + st.fronthits == 0){
+    printf(stdout, "bcstat: no hits after re-reading a block\n");
+    exit();
+  }
+  bcstat(&st, 0);
+  if(st.mhits + st.shits + st.fronthits + st.misses != 0){
+    printf(stdout, "bcstat: counters not cleared\n");
+    exit();
+  }
+
+  unlink("bcstat.tmp");
+  printf(stdout, "bcstat test ok\n");
+}
+
 unsigned long randstate = 1;
 unsigned int
 rand()
@@ -1796,6 +1841,7 @@ main(int argc, char *argv[])
   bigdir(); // slow
 
   uio();
+  bcstattest();
 
   exectest();
 
@@ -0,0 +1,343 @@
+// Disk driver for a virtio block device, through the legacy
+// PCI interface, as QEMU provides with
+//   -device virtio-blk-pci,drive=...,disable-modern=on
+// It takes ide.c's place in kernelvirtio (make qemu-virtio)
+// and keeps idesubmit()'s contract.
+//
+// Unlike IDE, the device takes many requests at once.  Each
+// request is a chain of descriptors in the shared virtqueue: a
+// header naming the operation and sector, one descriptor per
+// buf of the request, and a status byte for the device to fill
+// in.  idesubmit() puts the chain's head in the available ring and
+// notifies the device; the device finishes requests in any
+// order, puts their heads in the used ring and interrupts, and
+// ideintr() completes them.  A request waits only if the queue
+// has run out of descriptors.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "x86.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "buf.h"
+#include "iostat.h"
+
+#define VIRTIO_VENDOR 0x1af4
+#define VIRTIO_BLK    0x1001  // transitional block device
+
+// Legacy registers, from the I/O base in BAR0.
+#define VIO_FEATURES  0x04  // features the driver accepts
+#define VIO_QADDR     0x08  // queue's physical page number
+#define VIO_QSIZE     0x0c
+#define VIO_QSEL      0x0e
+#define VIO_QNOTIFY   0x10
+#define VIO_STATUS    0x12
+#define VIO_ISR       0x13  // reading it acknowledges the interrupt
+#define VIO_CAPACITY  0x14  // device size in sectors, 64 bits
+
+#define VS_ACK        0x01
+#define VS_DRIVER     0x02
+#define VS_DRIVER_OK  0x04
+
+#define VD_NEXT       0x01  // the chain continues at next
+#define VD_WRITE      0x02  // the device writes this buffer
+
+#define VBLK_IN       0     // read
+#define VBLK_OUT      1     // write
+
+#define SECTOR_SIZE   512
+#define VQMAX         256   // largest queue there is room for
+
+struct vdesc {
+  uint addr;
+  uint addrhi;
+  uint len;
+  ushort flags;
+  ushort next;
+};
+
+struct vavail {
+  ushort flags;
+  ushort idx;
+  ushort ring[VQMAX];
+};
+
+struct vused {
+  ushort flags;
+  ushort idx;
+  struct {
+    uint id;
+    uint len;
+  } ring[VQMAX];
+};
+
+// What a request needs besides its bufs, kept by the index of
+// its first descriptor.
+struct vreq {
+  struct {
+    uint type;
+    uint reserved;
+    uint sector;
+    uint sectorhi;
+  } hdr;
+  uchar status;
+  struct buf *b;
+};
+
+// The virtqueue: descriptors and the available ring, then the
+// used ring on the next page boundary.
+static char vqmem[3*PGSIZE] __attribute__((aligned(PGSIZE)));
+
+static struct {
+  struct spinlock lock;
+  ushort base;     // I/O base of the registers
+  int n;           // descriptors in the queue
+  struct vdesc *desc;
+  struct vavail *avail;
+  volatile struct vused *used;
+  ushort usedidx;  // next used entry to complete
+  ushort free[VQMAX];  // free descriptors
+  int nfree;
+  int inflight;    // requests submitted and not done
+  uint size;       // blocks on the device
+  struct vreq req[VQMAX];
+} vblk;
+
+static struct iostat idest;
+
+// Count v in log2 histogram h.
+static void
+iohist(uint *h, uint v)
+{
+  int i;
+
+  for(i = 0; i < NIOHIST-1 && (v >> (i+1)) != 0; i++)
+    ;
+  h[i]++;
+}
+
+void
+ideinit(void)
+{
+  int bdf, i;
+  uint bar, used;
+
+  initlock(&vblk.lock, "virtio");
+  if((bdf = pcifind(VIRTIO_VENDOR, VIRTIO_BLK)) < 0)
+    panic("virtio: no block device");
+  bar = pciread(bdf, 0x10);
+  if((bar & 1) == 0)
+    panic("virtio: BAR0 not I/O");
+  pciwrite(bdf, 0x04, (pciread(bdf, 0x04) & 0xffff) | 0x5);
+  vblk.base = bar & 0xfffc;
+
+  // Reset the device and tell it we drive it, with none of
+  // the optional features.
+  outb(vblk.base + VIO_STATUS, 0);
+  outb(vblk.base + VIO_STATUS, VS_ACK);
+  outb(vblk.base + VIO_STATUS, VS_ACK | VS_DRIVER);
+  outl(vblk.base + VIO_FEATURES, 0);
+
+  // The legacy interface fixes the queue size; lay the queue
+  // out for it.
+  outw(vblk.base + VIO_QSEL, 0);
+  vblk.n = inw(vblk.base + VIO_QSIZE);
+  if(vblk.n == 0 || vblk.n > VQMAX)
+    panic("virtio: queue size");
+  vblk.desc = (struct vdesc*)vqmem;
+  vblk.avail = (struct vavail*)(vqmem + vblk.n*sizeof(struct vdesc));
+  used = PGROUNDUP(vblk.n*sizeof(struct vdesc) + 2*(3 + vblk.n));
+  vblk.used = (struct vused*)(vqmem + used);
+  for(i = 0; i < vblk.n; i++)
+    vblk.free[i] = i;
+  vblk.nfree = vblk.n;
+  outl(vblk.base + VIO_QADDR, V2P(vqmem) / PGSIZE);
+
+  vblk.size = inl(vblk.base + VIO_CAPACITY) / (BSIZE/SECTOR_SIZE);
+
+  // The firmware routed the device's interrupt to a line.
+  diskirq = pciread(bdf, 0x3c) & 0xff;
+  ioapicenable(diskirq, ncpu - 1);
+
+  outb(vblk.base + VIO_STATUS, VS_ACK | VS_DRIVER | VS_DRIVER_OK);
+  cprintf("virtio: disk of %d blocks, queue of %d, irq %d\n",
+          vblk.size, vblk.n, diskirq);
+}
+
+// Take a free descriptor and link it after descriptor prev,
+// unless prev is -1.  Caller must hold vblk.lock.
+static int
+valloc(int prev, void *p, uint len, ushort flags)
+{
+  int d;
+
+  d = vblk.free[--vblk.nfree];
+  vblk.desc[d].addr = V2P(p);
+  vblk.desc[d].addrhi = 0;
+  vblk.desc[d].len = len;
+  vblk.desc[d].flags = flags;
+  vblk.desc[d].next = 0;
+  if(prev >= 0){
+    vblk.desc[prev].flags |= VD_NEXT;
+    vblk.desc[prev].next = d;
+  }
+  return d;
+}
+
+// Interrupt handler.
+void
+ideintr(void)
+{
+  struct buf *b, *c, *next, *async;
+  struct vreq *r;
+  int d;
+
+  acquire(&vblk.lock);
+  inb(vblk.base + VIO_ISR);
+
+  async = 0;
+  while(vblk.usedidx != vblk.used->idx){
+    __sync_synchronize();
+    d = vblk.used->ring[vblk.usedidx % vblk.n].id;
+    vblk.usedidx++;
+    r = &vblk.req[d];
+    if(r->status != 0)
+      panic("virtio: request failed");
+    b = r->b;
+    r->b = 0;
+
+    // Free the request's descriptors.
+    for(;;){
+      vblk.free[vblk.nfree++] = d;
+      if((vblk.desc[d].flags & VD_NEXT) == 0)
+        break;
+      d = vblk.desc[d].next;
+    }
+    vblk.inflight--;
+
+    // Wake process waiting for these bufs.  A request is all
+    // synchronous or all asynchronous; collect the asynchronous
+    // ones through qnext.
+    for(c = b; c != 0; c = c->cnext){
+      c->flags |= B_VALID;
+      c->flags &= ~B_DIRTY;
+      if(!(b->flags & B_ASYNC))
+        wakeup(c);
+    }
+    if(b->flags & B_ASYNC){
+      b->qnext = async;
+      async = b;
+    }
+  }
+  wakeup(&vblk.nfree);
+  release(&vblk.lock);
+
+  // Nobody waits for an asynchronous request; hand it back.
+  while((b = async) != 0){
+    async = b->qnext;
+    b->qnext = 0;
+    for(c = b; c != 0; c = next){
+      next = c->cnext;
+      c->cnext = 0;
+      c->flags &= ~B_ASYNC;
+      biodone(c);
+    }
+  }
+}
+
+//PAGEBREAK!
+// Queue a request to sync buf with disk, and return.
+// If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
+// Else if B_VALID is not set, read buf from disk, set B_VALID.
+// If B_ASYNC is set, ideintr() calls biodone() on each buf when
+// it finishes; otherwise the caller waits with ideiowait().
+// b->cnext may chain bufs for the following blocks, all locked
+// and all to be read or all to be written.
+void
+idesubmit(struct buf *b)
+{
+  struct buf *c;
+  struct vreq *r;
+  int n, head, d;
+
+  if(!holdingsleep(&b->lock))
+    panic("idesubmit: buf not locked");
+  if((b->flags & (B_VALID|B_DIRTY)) == B_VALID)
+    panic("idesubmit: nothing to do");
+  if(b->dev != 1)
+    panic("idesubmit: request not for disk 1");
+  n = 0;
+  for(c = b; c != 0; c = c->cnext){
+    if(c->dev != b->dev || c->blockno != b->blockno + n)
+      panic("idesubmit: chain");
+    n++;
+  }
+  if(b->blockno + n > vblk.size || n + 2 > vblk.n)
+    panic("idesubmit: request out of range");
+
+  acquire(&vblk.lock);
+
+  // A header, the bufs and the status byte.
+  while(vblk.nfree < n + 2)
+    sleep(&vblk.nfree, &vblk.lock);
+
+  head = vblk.free[vblk.nfree - 1];
+  r = &vblk.req[head];
+  r->hdr.type = (b->flags & B_DIRTY) ? VBLK_OUT : VBLK_IN;
+  r->hdr.reserved = 0;
+  r->hdr.sector = b->blockno * (BSIZE/SECTOR_SIZE);
+  r->hdr.sectorhi = 0;
+  r->status = 0xff;
+  r->b = b;
+  d = valloc(-1, &r->hdr, sizeof(r->hdr), 0);
+  for(c = b; c != 0; c = c->cnext)
+    d = valloc(d, c->data, BSIZE, (b->flags & B_DIRTY) ? 0 : VD_WRITE);
+  valloc(d, &r->status, 1, VD_WRITE);
+
+  // The request is in flight from here on, not while it
+  // waited for descriptors.
+  idest.reqs++;
+  idest.starts++;
+  idest.depth += vblk.inflight;
+  iohist(idest.depthhist, vblk.inflight);
+  vblk.inflight++;
+
+  // Make the chain available, then tell the device.
+  vblk.avail->ring[vblk.avail->idx % vblk.n] = head;
+  __sync_synchronize();
+  vblk.avail->idx++;
+  __sync_synchronize();
+  outw(vblk.base + VIO_QNOTIFY, 0);
+  release(&vblk.lock);
+}
+
+// Wait for the request that holds locked buf b, submitted
+// without B_ASYNC, to finish.
+void
+ideiowait(struct buf *b)
+{
+  if(!holdingsleep(&b->lock))
+    panic("ideiowait: buf not locked");
+
+  acquire(&vblk.lock);
+  while((b->flags & (B_VALID|B_DIRTY)) != B_VALID)
+    sleep(b, &vblk.lock);
+  release(&vblk.lock);
+}
+
+// Copy the disk request counters to *st; clear them if reset
+// is set.
+void
+idestat(struct iostat *st, int reset)
+{
+  acquire(&vblk.lock);
+  *st = idest;
+  if(reset)
+    memset(&idest, 0, sizeof(idest));
+  release(&vblk.lock);
+}
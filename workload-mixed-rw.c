@@ -3,6 +3,7 @@
 #include "user.h"
 #include "fs.h"
 #include "fcntl.h"
+#include "bcstat.h"
 
 void int_to_string(int num, char *str)
 {
@@ -39,9 +40,11 @@ void int_to_string(int num, char *str)
 
 int main()
 {
+	struct bcstat st;
 	int NUM_FILES = 100;
 	int LAST_CHARS_TO_COPY = 5;
 	int FILE_SIZE = 50;
+	bcstat(&st, 1);
 	for (int i = 0; i < NUM_FILES; i++)
 	{
 		char filename[20];
@@ -89,5 +92,8 @@ int main()
 		}
 		close(write_fd);
 	}
+	bcstat(&st, 0);
+	printf(2, "Hits: %d\n", st.mhits + st.shits + st.pinhits + st.fronthits);
+	printf(2, "Misses: %d\n", st.misses);
 	exit();
 }
\ No newline at end of file
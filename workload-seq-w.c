@@ -3,6 +3,7 @@
 #include "user.h"
 #include "fs.h"
 #include "fcntl.h"
+#include "bcstat.h"
 
 void int_to_string(int num, char *str)
 {
@@ -39,6 +40,9 @@ void int_to_string(int num, char *str)
 
 int main()
 {
+	struct bcstat st;
+
+	bcstat(&st, 1);
 	// Sequential reads and writes
 	for (int i = 0; i < 100; i++)
 	{
@@ -59,10 +63,8 @@ int main()
 			printf(1, "write %s failed\n", str);
 		close(wr);
 	}
-	// int hits = open("hits.txt", 0x001 | 0x200);
-	int h = 0;
-	int m = 0;
-	printf(2, "Hits: %d", h);
-	printf(2, "Misses: %d", m);
+	bcstat(&st, 0);
+	printf(2, "Hits: %d\n", st.mhits + st.shits + st.pinhits + st.fronthits);
+	printf(2, "Misses: %d\n", st.misses);
 	exit();
 }
\ No newline at end of file